@@ -0,0 +1,141 @@
+#pragma once
+#include <World.hpp>
+#include <algorithm>
+#include <vector>
+#include "Comps.hpp"
+
+// Owns the clip state of every animated entity in contiguous arrays, the Animator component only points into them.
+// Slots are added when an entity spawns and all cleared when the world is reset, animated entities aren't deleted on their own.
+// The kernel is branch free so the compiler can vectorize it, and the sprites are written back in bulk.
+class AnimationSystem
+{
+public:
+	Animator Add(tako::Entity entity, AnimationData* data, ClipData clip)
+	{
+		auto slot = static_cast<tako::U32>(m_entities.size());
+		m_entities.push_back(entity);
+		m_data.push_back(data);
+		m_clips.push_back(clip);
+		m_flipX.push_back(false);
+		m_passed.push_back(0);
+		m_inverseFrameDuration.push_back(0);
+		m_loopDuration.push_back(0);
+		m_inverseLoopDuration.push_back(0);
+		m_start.push_back(0);
+		m_lastFrame.push_back(0);
+		m_frame.push_back(0);
+		SetTiming(slot);
+		return {slot};
+	}
+
+	void Clear()
+	{
+		m_entities.clear();
+		m_data.clear();
+		m_clips.clear();
+		m_flipX.clear();
+		m_passed.clear();
+		m_inverseFrameDuration.clear();
+		m_loopDuration.clear();
+		m_inverseLoopDuration.clear();
+		m_start.clear();
+		m_lastFrame.clear();
+		m_frame.clear();
+	}
+
+	// Restarts the timer only when the clip changes
+	void PlayClip(Animator animator, ClipData clip)
+	{
+		auto& current = m_clips[animator.slot];
+		if (current.start == clip.start && current.end == clip.end)
+		{
+			return;
+		}
+		current = clip;
+		m_passed[animator.slot] = 0;
+		SetTiming(animator.slot);
+	}
+
+	void SetFlipX(Animator animator, bool flipX)
+	{
+		m_flipX[animator.slot] = flipX;
+	}
+
+	bool IsFlippedX(Animator animator) const
+	{
+		return m_flipX[animator.slot];
+	}
+
+	ClipData GetClip(Animator animator) const
+	{
+		return m_clips[animator.slot];
+	}
+
+	float GetPassed(Animator animator) const
+	{
+		return m_passed[animator.slot];
+	}
+
+	size_t GetLength() const
+	{
+		return m_entities.size();
+	}
+
+	// Any range of the slots can be updated on its own, so ranges can run on different threads while the world isn't changed
+	void Update(tako::World& world, float dt, size_t begin, size_t end)
+	{
+		Advance(dt, begin, end);
+		Apply(world, begin, end);
+	}
+private:
+	std::vector<tako::Entity> m_entities;
+	std::vector<AnimationData*> m_data;
+	std::vector<ClipData> m_clips;
+	std::vector<tako::U8> m_flipX;
+	std::vector<float> m_passed;
+	std::vector<float> m_inverseFrameDuration;
+	std::vector<float> m_loopDuration;
+	std::vector<float> m_inverseLoopDuration;
+	std::vector<tako::U32> m_start;
+	std::vector<tako::U32> m_lastFrame;
+	std::vector<tako::U32> m_frame;
+
+	void SetTiming(size_t i)
+	{
+		auto& clip = m_clips[i];
+		auto frameCount = clip.end - clip.start + 1;
+		m_inverseFrameDuration[i] = 1 / clip.duration;
+		m_loopDuration[i] = clip.duration * frameCount;
+		m_inverseLoopDuration[i] = 1 / m_loopDuration[i];
+		m_start[i] = clip.start;
+		m_lastFrame[i] = frameCount - 1;
+	}
+
+	void Advance(float dt, size_t begin, size_t end)
+	{
+		auto passed = m_passed.data();
+		auto inverseFrame = m_inverseFrameDuration.data();
+		auto loop = m_loopDuration.data();
+		auto inverseLoop = m_inverseLoopDuration.data();
+		auto start = m_start.data();
+		auto last = m_lastFrame.data();
+		auto frame = m_frame.data();
+		for (size_t i = begin; i < end; i++)
+		{
+			// Time is never negative, so truncating is flooring
+			auto t = passed[i] + dt;
+			t -= loop[i] * static_cast<tako::U32>(t * inverseLoop[i]);
+			passed[i] = t;
+			frame[i] = start[i] + std::min(static_cast<tako::U32>(t * inverseFrame[i]), last[i]);
+		}
+	}
+
+	void Apply(tako::World& world, size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			auto& sprites = m_flipX[i] ? m_data[i]->reverse : m_data[i]->sprites;
+			world.GetComponent<SpriteRenderer>(m_entities[i]).sprite = sprites[m_frame[i]];
+		}
+	}
+};
@@ -0,0 +1,118 @@
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include "Checks.hpp"
+#include "Game.hpp"
+#include "Replay.hpp"
+
+// Runs every check, fails if any of them found a difference
+int RunChecks()
+{
+	struct Check
+	{
+		const char* name;
+		int (*run)();
+	};
+	constexpr Check Checks[] =
+	{
+		{"Animation", &CheckAnimation},
+		{"Collision", &CheckCollision},
+		{"LevelIndex", &CheckLevelIndex}
+	};
+	int failed = 0;
+	for (auto& check : Checks)
+	{
+		auto mismatches = check.run();
+		fmt::print("{:<20}{} mismatches\n", check.name, mismatches);
+		failed += mismatches != 0;
+	}
+	return failed == 0 ? 0 : 1;
+}
+
+// Headless simulation benchmark on World.ldtk, fixed dt and scripted input by default:
+//   BaseClockBench [ticks]
+//   BaseClockBench --replay <file>   replays a recording and fails on the first diverging frame
+//   BaseClockBench --check           compares the optimized systems with reference versions and fails on any difference
+// With BASECLOCK_TRACE set to a file the scoped timer samples are written there as a Chrome trace
+int main(int argc, char* argv[])
+{
+	if (argc > 1 && std::strcmp(argv[1], "--check") == 0)
+	{
+		return RunChecks();
+	}
+	int ticks = 100000;
+	ReplayPlayer replay;
+	if (argc > 2 && std::strcmp(argv[1], "--replay") == 0)
+	{
+		if (!replay.Open(argv[2]))
+		{
+			fmt::print("Could not open replay {}\n", argv[2]);
+			return 1;
+		}
+	}
+	else if (argc > 1)
+	{
+		ticks = std::atoi(argv[1]);
+	}
+	constexpr float dt = 1.0f / 60;
+
+	auto tracePath = std::getenv("BASECLOCK_TRACE");
+	Profiler::Get().SetEnabled(tracePath != nullptr);
+	auto game = std::make_unique<Game>();
+	game->SetupHeadless();
+	SystemTimings timings;
+	game->SetTimings(&timings);
+
+	FrameData frameData;
+	std::vector<tako::U8> arenaMemory(FrameArenaSize);
+	FrameArena arena(arenaMemory.data(), arenaMemory.size());
+	int tick = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (replay.IsOpen() || tick < ticks)
+	{
+		ReplayFrame frame;
+		if (replay.IsOpen())
+		{
+			if (!replay.Next(frame))
+			{
+				break;
+			}
+		}
+		else
+		{
+			// Get past the title, then run back and forth across the level, jumping and dashing in a fixed rhythm
+			frame.dt = dt;
+			frame.input.any = tick == 0;
+			frame.input.moveX = (tick / 600) % 2 == 0 ? 1 : -1;
+			frame.input.jump = tick % 90 < 20;
+			frame.input.dash = tick % 150 == 0;
+			frame.input.up = tick % 300 == 1;
+		}
+
+		new (&frameData) FrameData();
+		arena.Reset();
+		frameData.arena = &arena;
+		game->Tick(&frameData, frame.input, frame.dt);
+		tick++;
+
+		if (replay.IsOpen() && game->HashState() != frame.hash)
+		{
+			fmt::print("Replay diverged at frame {}\n", tick);
+			return 1;
+		}
+	}
+	std::chrono::duration<double> passed = std::chrono::steady_clock::now() - start;
+
+	fmt::print("Simulated {} ticks in {:.3f}s ({:.0f} ticks/s)\n", tick, passed.count(), tick / passed.count());
+	for (size_t i = 0; i < timings.seconds.size(); i++)
+	{
+		fmt::print("{:<20}{:>10.3f}ms{:>10.3f}us/tick\n", SystemNames[i], timings.seconds[i] * 1000, timings.seconds[i] * 1000000 / tick);
+	}
+	if (tracePath && !Profiler::Get().WriteChromeTrace(tracePath))
+	{
+		fmt::print("Could not write trace to {}\n", tracePath);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,306 @@
+#pragma once
+#include <World.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <random>
+#include <variant>
+#include <vector>
+#include "Animation.hpp"
+#include "Comps.hpp"
+#include "LevelData.hpp"
+#include "LevelIndex.hpp"
+#include "Physics.hpp"
+
+// Checks of the optimized systems against the straightforward versions they replaced, run by BaseClockBench --check.
+// Each returns how many results differed.
+
+// The animation kernel against the per animator loop it replaced, over random clips, flips and time steps
+inline int CheckAnimation()
+{
+	constexpr size_t FrameCount = 9;
+	constexpr ClipData Clips[] = {{0, 1, 0.4f}, {2, 5, 0.15f}, {6, 8, 0.1f}, {3, 3, 0.2f}};
+	// The sprites are never drawn, they only have to be told apart
+	AnimationData data;
+	for (size_t i = 0; i < FrameCount; i++)
+	{
+		data.sprites.push_back(reinterpret_cast<tako::OpenGLSprite*>(std::uintptr_t(i + 1) * 16));
+		data.reverse.push_back(reinterpret_cast<tako::OpenGLSprite*>(std::uintptr_t(i + 1) * 16 + 8));
+	}
+
+	struct Reference
+	{
+		tako::Entity entity;
+		Animator animator;
+		ClipData clip;
+		bool flipX;
+		float passed;
+	};
+	std::mt19937 rng(1);
+	tako::World world;
+	AnimationSystem animation;
+	std::vector<Reference> references;
+	for (size_t i = 0; i < 64; i++)
+	{
+		auto clip = Clips[rng() % std::size(Clips)];
+		auto entity = world.Create(SpriteRenderer{data.sprites[0]});
+		references.push_back({entity, animation.Add(entity, &data, clip), clip, false, 0});
+	}
+
+	int mismatches = 0;
+	std::uniform_real_distribution<float> randomDelta(0.001f, 0.05f);
+	for (int step = 0; step < 20000; step++)
+	{
+		auto& changed = references[rng() % references.size()];
+		auto clip = Clips[rng() % std::size(Clips)];
+		if (changed.clip.start != clip.start || changed.clip.end != clip.end)
+		{
+			changed.clip = clip;
+			changed.passed = 0;
+		}
+		changed.flipX = rng() % 2;
+		animation.PlayClip(changed.animator, clip);
+		animation.SetFlipX(changed.animator, changed.flipX);
+
+		float dt = step % 2 ? 1.0f / 60 : randomDelta(rng);
+		animation.Update(world, dt, 0, animation.GetLength());
+		for (auto& ref : references)
+		{
+			ref.passed += dt;
+			auto totalDuration = ref.clip.duration * (ref.clip.end - ref.clip.start + 1);
+			while (ref.passed >= totalDuration)
+			{
+				ref.passed -= totalDuration;
+			}
+			size_t frame = ref.clip.start + std::floor(ref.passed / ref.clip.duration);
+			auto expected = ref.flipX ? data.reverse[frame] : data.sprites[frame];
+			auto& sprite = world.GetComponent<SpriteRenderer>(ref.entity).sprite;
+			if (!std::holds_alternative<tako::OpenGLSprite*>(sprite) || std::get<tako::OpenGLSprite*>(sprite) != expected)
+			{
+				mismatches++;
+			}
+		}
+	}
+	return mismatches;
+}
+
+// Reads the imported byte grid tile by tile, like the collision did before the rows were bit packed
+struct ReferenceCollision
+{
+	const std::vector<tako::U8>& tiles;
+	int width;
+	int height;
+
+	bool IsSolid(int x, int y) const
+	{
+		if (x < 0 || y < 0 || x >= width || y >= height)
+		{
+			return false;
+		}
+		return tiles[(height - 1 - y) * width + x];
+	}
+
+	bool IsColumnSolid(int x, int rowStart, int rowEnd) const
+	{
+		for (int y = rowStart; y <= rowEnd; y++)
+		{
+			if (IsSolid(x, y))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool IsRowSolid(int y, int columnStart, int columnEnd) const
+	{
+		for (int x = columnStart; x <= columnEnd; x++)
+		{
+			if (IsSolid(x, y))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	float SweepX(Rect& rect, float dx) const
+	{
+		int rowStart = TileStart(rect.Bottom());
+		int rowEnd = TileEnd(rect.Top());
+		auto start = rect.x;
+		if (dx > 0)
+		{
+			for (int x = TileEnd(rect.Right()) + 1; x <= TileEnd(rect.Right() + dx); x++)
+			{
+				if (IsColumnSolid(x, rowStart, rowEnd))
+				{
+					rect.x = x * TileSize - rect.w / 2;
+					return dx - (rect.x - start);
+				}
+			}
+		}
+		else if (dx < 0)
+		{
+			for (int x = TileStart(rect.Left()) - 1; x >= TileStart(rect.Left() + dx); x--)
+			{
+				if (IsColumnSolid(x, rowStart, rowEnd))
+				{
+					rect.x = (x + 1) * TileSize + rect.w / 2;
+					return (rect.x - start) - dx;
+				}
+			}
+		}
+		rect.x += dx;
+		return 0;
+	}
+
+	float SweepY(Rect& rect, float dy) const
+	{
+		int columnStart = TileStart(rect.Left());
+		int columnEnd = TileEnd(rect.Right());
+		auto start = rect.y;
+		if (dy > 0)
+		{
+			for (int y = TileEnd(rect.Top()) + 1; y <= TileEnd(rect.Top() + dy); y++)
+			{
+				if (IsRowSolid(y, columnStart, columnEnd))
+				{
+					rect.y = y * TileSize - rect.h / 2;
+					return dy - (rect.y - start);
+				}
+			}
+		}
+		else if (dy < 0)
+		{
+			for (int y = TileStart(rect.Bottom()) - 1; y >= TileStart(rect.Bottom() + dy); y--)
+			{
+				if (IsRowSolid(y, columnStart, columnEnd))
+				{
+					rect.y = (y + 1) * TileSize + rect.h / 2;
+					return (rect.y - start) - dy;
+				}
+			}
+		}
+		rect.y += dy;
+		return 0;
+	}
+};
+
+// The cooked solid rows and rects and the word based sweeps against the byte grid, on random grids and moves
+inline int CheckCollision()
+{
+	std::mt19937 rng(1);
+	int mismatches = 0;
+	for (int grid = 0; grid < 300; grid++)
+	{
+		int width = 1 + rng() % 150;
+		int height = 1 + rng() % 40;
+		std::vector<tako::U8> tiles(width * height);
+		for (auto& tile : tiles)
+		{
+			tile = rng() % 7 == 0;
+		}
+		ReferenceCollision reference{tiles, width, height};
+		int rowWords = (width + 63) / 64;
+		auto rows = LevelCooking::PackSolidRows(tiles, width, height, rowWords);
+		TileCollision collision{{rows.data(), rows.size()}, rowWords, width, height};
+
+		// Every solid tile is covered by exactly one rect, nothing else is covered
+		std::vector<int> covered(tiles.size(), 0);
+		for (auto& rect : LevelCooking::MergeSolidRects(tiles, width, height))
+		{
+			for (int y = rect.y; y < rect.y + rect.height; y++)
+			{
+				for (int x = rect.x; x < rect.x + rect.width; x++)
+				{
+					covered[y * width + x]++;
+				}
+			}
+		}
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				mismatches += covered[y * width + x] != reference.IsSolid(x, y);
+				mismatches += collision.IsSolid(x, y) != reference.IsSolid(x, y);
+			}
+		}
+
+		for (int move = 0; move < 200; move++)
+		{
+			float x = static_cast<int>(rng() % (width * TileSize + 64)) - 32.0f;
+			float y = static_cast<int>(rng() % (height * TileSize + 64)) - 32.0f;
+			float delta = static_cast<int>(rng() % 1600) - 800 + (rng() % 100) / 100.0f;
+			Rect rect(x, y, 12, 16);
+			Rect expected = rect;
+			mismatches += SweepX(collision, rect, delta) != reference.SweepX(expected, delta) || rect.x != expected.x;
+			mismatches += SweepY(collision, rect, delta) != reference.SweepY(expected, delta) || rect.y != expected.y;
+
+			int columnStart = static_cast<int>(rng() % (width + 4)) - 2;
+			int columnEnd = columnStart + rng() % 70;
+			for (int row = -2; row < height + 2; row++)
+			{
+				mismatches += collision.IsRowSolid(row, columnStart, columnEnd) != reference.IsRowSolid(row, columnStart, columnEnd);
+			}
+		}
+	}
+	return mismatches;
+}
+
+// Level lookups through the index against a scan over all levels, on random worlds of up to 300 levels
+inline int CheckLevelIndex()
+{
+	std::mt19937 rng(1);
+	int mismatches = 0;
+	for (int levelCount : {0, 1, 3, 5, 17, 300})
+	{
+		LevelWorld world;
+		world.levels.resize(levelCount);
+		for (auto& level : world.levels)
+		{
+			level.worldX = (rng() % 60) * 64;
+			level.worldY = (rng() % 60) * 64;
+			level.size = tako::Vector2(64 * (1 + rng() % 4), 64 * (1 + rng() % 3));
+		}
+		LevelIndex index;
+		index.Build(world);
+
+		auto overlaps = [&](const Level& level, tako::Vector2 min, tako::Vector2 max)
+		{
+			return min.x <= level.worldX + level.size.x && level.worldX <= max.x && min.y <= level.worldY + level.size.y && level.worldY <= max.y;
+		};
+		for (int query = 0; query < 3000; query++)
+		{
+			tako::Vector2 point(rng() % 4200, rng() % 4200);
+			int exclude = levelCount > 0 ? rng() % levelCount : -1;
+			std::optional<int> expected;
+			for (int i = 0; i < levelCount && !expected; i++)
+			{
+				if (i != exclude && overlaps(world.levels[i], point, point))
+				{
+					expected = i;
+				}
+			}
+			mismatches += index.FindLevel(point, exclude) != expected;
+
+			tako::Vector2 min = point - tako::Vector2(48, 48);
+			tako::Vector2 max = point + tako::Vector2(48, 48);
+			std::vector<int> found;
+			index.QueryRect(min, max, [&](int id) { found.push_back(id); });
+			std::sort(found.begin(), found.end());
+			std::vector<int> expectedFound;
+			for (int i = 0; i < levelCount; i++)
+			{
+				if (overlaps(world.levels[i], min, max))
+				{
+					expectedFound.push_back(i);
+				}
+			}
+			mismatches += found != expectedFound;
+		}
+	}
+	return mismatches;
+}
@@ -0,0 +1,156 @@
+#pragma once
+#include <World.hpp>
+#include <algorithm>
+#include <new>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "FrameArena.hpp"
+
+enum class CommandKind : tako::U8
+{
+	Create,
+	AddComponent,
+	RemoveComponent
+};
+
+// Structural changes recorded while the world is being iterated, applied together at the sync points of a tick.
+// Deletions are applied last, so commands recorded for an entity before it was deleted still find it.
+// Payloads are allocated from the frame arena, so the buffer has to be flushed or cleared before the arena is reset.
+class CommandBuffer
+{
+public:
+	explicit CommandBuffer(FrameArena* arena = nullptr) : m_arena(arena ? arena : &m_heap)
+	{
+	}
+
+	CommandBuffer(const CommandBuffer&) = delete;
+	CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+	~CommandBuffer()
+	{
+		Clear();
+	}
+
+	template<typename... Cs>
+	void Create(Cs... comps)
+	{
+		Record<std::tuple<Cs...>>(CommandKind::Create, 0, &ApplyCreate<Cs...>, std::move(comps)...);
+	}
+
+	void Delete(tako::Entity entity)
+	{
+		m_deletes.push_back(entity);
+	}
+
+	template<typename T>
+	void AddComponent(tako::Entity entity, T comp)
+	{
+		Record<T>(CommandKind::AddComponent, entity, &ApplyAddComponent<T>, std::move(comp));
+	}
+
+	template<typename T>
+	void RemoveComponent(tako::Entity entity)
+	{
+		m_commands.push_back({CommandKind::RemoveComponent, entity, nullptr, &ApplyRemoveComponent<T>});
+	}
+
+	bool IsEmpty() const
+	{
+		return m_commands.empty() && m_deletes.empty();
+	}
+
+	// Applies everything in the order it was recorded, the buffers keep their capacity for the next tick
+	void Flush(tako::World& world)
+	{
+		for (auto& command : m_commands)
+		{
+			command.apply(&world, command.entity, command.payload, *m_arena);
+		}
+		m_commands.clear();
+		std::sort(m_deletes.begin(), m_deletes.end());
+		m_deletes.erase(std::unique(m_deletes.begin(), m_deletes.end()), m_deletes.end());
+		for (auto entity : m_deletes)
+		{
+			world.Delete(entity);
+		}
+		m_deletes.clear();
+	}
+
+	// For when the world is reset with commands still pending
+	void Clear()
+	{
+		for (auto& command : m_commands)
+		{
+			if (command.kind != CommandKind::RemoveComponent)
+			{
+				command.apply(nullptr, command.entity, command.payload, *m_arena);
+			}
+		}
+		m_commands.clear();
+		m_deletes.clear();
+	}
+private:
+	// Moves the payload into the world and releases it, without a world it is only released
+	using Apply = void (*)(tako::World* world, tako::Entity entity, void* payload, FrameArena& arena);
+
+	struct Command
+	{
+		CommandKind kind;
+		tako::Entity entity;
+		void* payload;
+		Apply apply;
+	};
+
+	FrameArena* m_arena;
+	// Without an arena every payload goes to the heap
+	FrameArena m_heap;
+	std::vector<Command> m_commands;
+	std::vector<tako::Entity> m_deletes;
+
+	template<typename P, typename... Args>
+	void Record(CommandKind kind, tako::Entity entity, Apply apply, Args&&... args)
+	{
+		auto payload = new (m_arena->Allocate(sizeof(P), alignof(P))) P(std::forward<Args>(args)...);
+		m_commands.push_back({kind, entity, payload, apply});
+	}
+
+	template<typename P>
+	static void Release(P* payload, FrameArena& arena)
+	{
+		payload->~P();
+		arena.Deallocate(payload, alignof(P));
+	}
+
+	template<typename... Cs>
+	static void ApplyCreate(tako::World* world, tako::Entity entity, void* payload, FrameArena& arena)
+	{
+		auto comps = static_cast<std::tuple<Cs...>*>(payload);
+		if (world)
+		{
+			std::apply([&](Cs&... c) { world->Create(std::move(c)...); }, *comps);
+		}
+		Release(comps, arena);
+	}
+
+	template<typename T>
+	static void ApplyAddComponent(tako::World* world, tako::Entity entity, void* payload, FrameArena& arena)
+	{
+		auto comp = static_cast<T*>(payload);
+		if (world)
+		{
+			world->AddComponent<T>(entity);
+			new (&world->GetComponent<T>(entity)) T(std::move(*comp));
+		}
+		Release(comp, arena);
+	}
+
+	template<typename T>
+	static void ApplyRemoveComponent(tako::World* world, tako::Entity entity, void* payload, FrameArena& arena)
+	{
+		if (world)
+		{
+			world->RemoveComponent<T>(entity);
+		}
+	}
+};
@@ -13,6 +13,8 @@ using Rect = tako::Jam::PlatformerPhysics2D::Rect;
 struct Position
 {
 	tako::Vector2 position;
+	// Position at the start of the current simulation step, drawing blends from it
+	tako::Vector2 previous;
 };
 
 struct RectRenderer
@@ -32,6 +34,7 @@ struct RigidBody
 {
 	tako::Vector2 velocity;
 	Rect bounds;
+	tako::Vector2 movement = {0, 0};
 
 	Rect CalcRec(tako::Vector2 position)
 	{
@@ -51,8 +54,8 @@ struct Player
 	int spawnID = 0;
 	int spawnMap = 0;
 	float airTime = 0;
-	float prevYVelocity = 0;
 	bool grounded = false;
+	bool wasGrounded = true;
 	float dashCooldown = 0.0f;
 	float usedDashes = 0;
 	float stepCounter = 0;
@@ -65,6 +68,7 @@ struct Camera
 {
 	bool snapped = false;
 	tako::Vector2 position;
+	tako::Vector2 previous;
 };
 
 struct PlayerSpawn
@@ -108,27 +112,8 @@ struct AnimationData
 	}
 };
 
+// Slot of the entity's clip state in the AnimationSystem
 struct Animator
 {
-	AnimationData* data;
-	ClipData clip;
-	bool flipX = false;
-	float passed = 0;
-
-	void PlayClip(ClipData newClip)
-	{
-		if (clip.start == newClip.start && clip.end == newClip.end)
-		{
-			return;
-		}
-		passed = 0;
-		clip = newClip;
-	}
-};
-
-struct FadeOut
-{
-	tako::U8 startFade;
-	float duration;
-	float left = duration;
+	tako::U32 slot;
 };
@@ -0,0 +1,124 @@
+#pragma once
+#include <Math.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Bytes reserved behind FrameData in tako's frame data memory
+constexpr const size_t FrameArenaSize = 64 * 1024;
+
+// Bump allocator for allocations that only live until the end of the frame, nothing is freed individually.
+// When it runs out it falls back to the heap so a busy frame degrades instead of failing.
+class FrameArena
+{
+public:
+	FrameArena() = default;
+
+	FrameArena(void* memory, size_t size) : m_begin(static_cast<tako::U8*>(memory)), m_size(size)
+	{
+	}
+
+	void* Allocate(size_t size, size_t alignment)
+	{
+		auto address = reinterpret_cast<std::uintptr_t>(m_begin) + m_used;
+		auto aligned = (address + alignment - 1) & ~(std::uintptr_t(alignment) - 1);
+		auto offset = aligned - reinterpret_cast<std::uintptr_t>(m_begin);
+		if (m_begin && offset + size <= m_size)
+		{
+			m_used = offset + size;
+			return m_begin + offset;
+		}
+		m_overflowed = true;
+		return ::operator new(size, std::align_val_t(alignment));
+	}
+
+	// Takes the alignment it was allocated with, heap fallbacks have to be freed with the matching delete
+	void Deallocate(void* ptr, size_t alignment)
+	{
+		if (!Owns(ptr))
+		{
+			::operator delete(ptr, std::align_val_t(alignment));
+		}
+	}
+
+	bool Owns(const void* ptr) const
+	{
+		auto bytes = static_cast<const tako::U8*>(ptr);
+		return bytes >= m_begin && bytes < m_begin + m_size;
+	}
+
+	void Reset()
+	{
+		m_used = 0;
+		m_overflowed = false;
+	}
+
+	size_t GetUsed() const
+	{
+		return m_used;
+	}
+
+	// Set when an allocation of this frame didn't fit and went to the heap
+	bool HasOverflowed() const
+	{
+		return m_overflowed;
+	}
+private:
+	tako::U8* m_begin = nullptr;
+	size_t m_size = 0;
+	size_t m_used = 0;
+	bool m_overflowed = false;
+};
+
+template<typename T>
+class ArenaAllocator
+{
+public:
+	using value_type = T;
+
+	ArenaAllocator(FrameArena* arena) : m_arena(arena)
+	{
+	}
+
+	template<typename U>
+	ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.GetArena())
+	{
+	}
+
+	T* allocate(size_t count)
+	{
+		return static_cast<T*>(m_arena->Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* ptr, size_t count)
+	{
+		m_arena->Deallocate(ptr, alignof(T));
+	}
+
+	FrameArena* GetArena() const
+	{
+		return m_arena;
+	}
+
+	template<typename U>
+	bool operator==(const ArenaAllocator<U>& other) const
+	{
+		return m_arena == other.GetArena();
+	}
+
+	template<typename U>
+	bool operator!=(const ArenaAllocator<U>& other) const
+	{
+		return m_arena != other.GetArena();
+	}
+private:
+	FrameArena* m_arena;
+};
+
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+template<typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -1,6 +1,9 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include "Audio.hpp"
+#include "FrameArena.hpp"
+#include "SoundBank.hpp"
 
 enum class GameState
 {
@@ -15,20 +18,36 @@ struct FrameData
 	int collectedCount;
 	bool showDialog;
 	bool tutorialDialogOpen;
+	// How far drawing is between the last two simulation steps
+	float interpolation = 1;
+	// Transient allocations of the frame, reset when the next frame starts
+	FrameArena* arena = nullptr;
 };
 
 struct SharedData
 {
-	tako::Audio* audio;
+	tako::Audio* audio = nullptr;
+	SoundBank sounds;
 	std::string targetText = "";
 	int textDisplayed = 0;
 	float textPassed = 0;
 	float textBreakpoint = 0;
 	float textTutorial = 0;
 
-	void ShowText(std::string str, bool tutorial = false)
+	void PlaySound(Sound sound)
 	{
-		targetText = str;
+		sounds.Play(sound);
+	}
+
+	SharedData()
+	{
+		// Dialogs are copied in without allocating once it has grown to the longest one
+		targetText.reserve(128);
+	}
+
+	void ShowText(std::string_view str, bool tutorial = false)
+	{
+		targetText.assign(str.data(), str.size());
 		textDisplayed = 0;
 		textPassed = 0;
 		textBreakpoint = 0;
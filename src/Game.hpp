@@ -4,82 +4,141 @@
 #include <World.hpp>
 #include <PlatformerPhysics2D.hpp>
 #include <Jam/LDtkImporter.hpp>
+#include "Animation.hpp"
+#include "CommandBuffer.hpp"
 #include "Comps.hpp"
 #include "Entity.hpp"
-#include <Font.hpp>
 #include "Event.hpp"
 #include "FrameData.hpp"
-#include "Jam/TileMap.hpp"
+#include "InputState.hpp"
+#include "LayerTextureCache.hpp"
+#include "LevelIndex.hpp"
+#include "LevelData.hpp"
+#include "LevelStreamer.hpp"
 #include "OpenGLSprite.hpp"
+#include "Particles.hpp"
+#include "Physics.hpp"
 #include "Player.hpp"
+#include "Query.hpp"
 #include "Reflection.hpp"
-#include "SmallVec.hpp"
+#include "Replay.hpp"
+#include "Scheduler.hpp"
+#include "Singleton.hpp"
+#include "SpriteBatch.hpp"
+#include "TextRenderer.hpp"
 #include "Sprite.hpp"
+#include "Timings.hpp"
+#include "WorldWatcher.hpp"
+#include <cstdlib>
 #include <variant>
-#include <sstream>
 #ifdef TAKO_IMGUI
 #include "imgui.h"
 #endif
 
 
-template <typename T>
-void AssignLDtkField(const char* typeName, void* data, nlohmann::json& json, const tako::Reflection::StructInformation::Field& info)
+struct SpawnBinding
 {
-	for (auto& field : json)
-	{
-		if (field["__type"] == typeName)
-		{
-			*reinterpret_cast<T*>(reinterpret_cast<tako::U8*>(data) + info.offset) = field["__value"];
-		}
-	}
-}
+	size_t offset;
+	size_t valueIndex;
+	LevelFieldType type;
+};
 
-inline void ApplyLDtkFields(void* data, nlohmann::json& json, const tako::Reflection::StructInformation* structType)
+struct SpawnPlan;
+using SpawnPrepare = std::function<EntitySpawn(const SpawnPlan&, const LevelEntity&)>;
+
+// Resolved once per entity type, spawning is then a jump into prepare and copying the bound values
+struct SpawnPlan
 {
+	std::vector<SpawnBinding> bindings;
+	SpawnPrepare prepare;
+};
+
+inline std::vector<SpawnBinding> BindLDtkFields(const LevelEntityType& entityType, const tako::Reflection::StructInformation* structType)
+{
+	std::vector<SpawnBinding> bindings;
 	for (auto& info : structType->fields)
 	{
+		LevelFieldType type;
 		if (tako::Reflection::GetPrimitiveInformation<int>() == info.type)
 		{
-			AssignLDtkField<int>("Int", data, json, info);
+			type = LevelFieldType::Int;
 		}
 		else if (tako::Reflection::GetPrimitiveInformation<bool>() == info.type)
 		{
-			AssignLDtkField<bool>("Bool", data, json, info);
+			type = LevelFieldType::Bool;
+		}
+		else
+		{
+			continue;
+		}
+		for (size_t i = 0; i < entityType.fields.size(); i++)
+		{
+			auto& [name, fieldType] = entityType.fields[i];
+			if (fieldType == type && std::string_view(info.name) == name)
+			{
+				bindings.push_back({info.offset, i, type});
+			}
+		}
+	}
+	return bindings;
+}
+
+inline void ApplyLDtkFields(void* data, const std::vector<SpawnBinding>& bindings, ArrayView<tako::I32> values)
+{
+	for (auto& binding : bindings)
+	{
+		auto target = reinterpret_cast<tako::U8*>(data) + binding.offset;
+		switch (binding.type)
+		{
+			case LevelFieldType::Int:
+				*reinterpret_cast<int*>(target) = values[binding.valueIndex];
+				break;
+			case LevelFieldType::Bool:
+				*reinterpret_cast<bool*>(target) = values[binding.valueIndex] != 0;
+				break;
 		}
 	}
 }
 
 
 template<typename T>
-tako::Entity SpawnTileEntity(tako::World& world, tako::Jam::TileEntity& entDef)
+T PrepareTileComponent(const SpawnPlan& plan, const LevelEntity& entDef)
+{
+	T comp{};
+	ApplyLDtkFields(&comp, plan.bindings, entDef.values);
+	return comp;
+}
+
+template<typename T>
+tako::Entity SpawnTileEntity(tako::World& world, tako::Vector2 position, const T& prepared)
 {
 	auto ent = world.Create
 	(
-		Position{{entDef.position}}
+		Position{position, position}
 	);
 
 
 	world.AddComponent<T>(ent);
 	auto& comp = world.GetComponent<T>(ent);
-	new (&comp) T();
-	ApplyLDtkFields(&comp, entDef.fields, tako::Reflection::Resolver::Get<T>());
+	new (&comp) T(prepared);
 	return ent;
 }
 
-inline tako::Texture CreateText(tako::OpenGLPixelArtDrawer* drawer, tako::Font* font, std::string_view text)
-{
-	auto bitmap = font->RenderText(text, 1);
-    return drawer->CreateTexture(bitmap);
-}
-
-inline void UpdateText(tako::OpenGLPixelArtDrawer* drawer, tako::Font* font, std::string_view text, tako::Texture& tex)
-{
-	auto bitmap = font->RenderText(text, 1);
-    drawer->UpdateTexture(tex, bitmap);
-}
-
 using Rect = tako::Jam::PlatformerPhysics2D::Rect;
 
+constexpr const int TargetWidth = 240;
+constexpr const int TargetHeight = 135;
+constexpr const size_t LayerTextureBudget = 8 * 1024 * 1024;
+constexpr const size_t LayerUploadBytesPerFrame = 256 * 1024;
+constexpr const float DefaultTickRate = 60;
+constexpr const char* ProfilerTraceFile = "BaseClock.trace.json";
+constexpr const std::string_view PromptText = "   Press [UP] to  \nactivate the clock";
+// Simulation time that can't be caught up within this many steps in a frame is dropped
+constexpr const int MaxStepsPerFrame = 5;
+constexpr const size_t MaxWorkerThreads = 6;
+// Animators per job, fewer aren't worth handing to another thread
+constexpr const size_t AnimationChunkSize = 256;
+
 inline tako::Vector2 FitMapBound(Rect bounds, tako::Vector2 cameraPos, tako::Vector2 camSize)
 {
     cameraPos.x = std::max(bounds.Left() + camSize.x / 2, cameraPos.x);
@@ -90,6 +149,11 @@ inline tako::Vector2 FitMapBound(Rect bounds, tako::Vector2 cameraPos, tako::Vec
     return cameraPos;
 }
 
+inline tako::Vector2 Interpolate(tako::Vector2 from, tako::Vector2 to, float t)
+{
+	return from + (to - from) * t;
+}
+
 
 class Game
 {
@@ -97,20 +161,23 @@ public:
 	template<typename T>
 	void RegisterTileEntity()
 	{
-		auto info = tako::Reflection::Resolver::Get<T>();
-		m_entityInstantiate[info->name] = &SpawnTileEntity<T>;
+		RegisterTileEntity<T>([](tako::World& world, auto ent, auto& entDef) {});
 	}
 
 	template<typename T, typename Cb>
 	void RegisterTileEntity(Cb&& callback)
 	{
 		auto info = tako::Reflection::Resolver::Get<T>();
-		m_entityInstantiate[info->name] = [=](tako::World& world, tako::Jam::TileEntity& entDef)
+		m_entityTypes[info->name] = {info, [=](const SpawnPlan& plan, const LevelEntity& entDef) -> EntitySpawn
 		{
-			auto ent = SpawnTileEntity<T>(world, entDef);
-			callback(world, ent, entDef);
-			return ent;
-		};
+			auto comp = PrepareTileComponent<T>(plan, entDef);
+			return [=](tako::World& world)
+			{
+				auto ent = SpawnTileEntity<T>(world, entDef.position, comp);
+				callback(world, ent, entDef);
+				return ent;
+			};
+		}};
 	}
 
 	Game()
@@ -129,18 +196,80 @@ public:
 			auto& ren = world.GetComponent<SpriteRenderer>(ent);
 			ren.sprite = m_collectibleSprite;
 		});
+		m_streamer.Init([&](int id) { return PrepareLevel(id); });
+	}
+
+	// Runs on the streaming thread, must only read the level data and the registered entity types
+	PreparedLevel PrepareLevel(int id)
+	{
+		// Only the profiler may see it, the timings belong to the main thread
+		ScopedSystemTimer timer(nullptr, SystemID::PrepareLevel);
+		auto& level = m_tileWorld.levels[id];
+		PreparedLevel prepared;
+		prepared.id = id;
+		prepared.spawns.reserve(level.entities.size());
+		for (auto& entDef : level.entities)
+		{
+			auto& plan = m_spawnPlans[entDef.typeID];
+			if (plan.prepare)
+			{
+				prepared.spawns.push_back(plan.prepare(plan, entDef));
+			}
+		}
+		return prepared;
+	}
+
+	void BuildSpawnPlans()
+	{
+		m_spawnPlans.clear();
+		for (auto& entityType : m_tileWorld.types)
+		{
+			auto& plan = m_spawnPlans.emplace_back();
+			auto it = m_entityTypes.find(entityType.name);
+			if (it == m_entityTypes.end())
+			{
+				LOG("Entity type {} is not registered, its entities won't be spawned", entityType.name);
+				continue;
+			}
+			plan.bindings = BindLDtkFields(entityType, it->second.info);
+			plan.prepare = it->second.prepare;
+		}
+	}
+
+	// Starts preparing the neighbours the player is getting close to, so moving into them only has to swap the level
+	void PrefetchNeighbours()
+	{
+		constexpr float prefetchDistance = 48;
+		if (m_player.IsBound())
+		{
+			auto& pos = *m_player.Get<Position>(m_world);
+			tako::Vector2 worldPos(pos.position.x + m_activeLevel->worldX, m_activeLevel->worldY + m_activeLevel->size.y - pos.position.y);
+			tako::Vector2 reach(prefetchDistance, prefetchDistance);
+			m_levelIndex.QueryRect(worldPos - reach, worldPos + reach, [&](int neighbourID)
+			{
+				if (neighbourID == m_activeLevelID)
+				{
+					return;
+				}
+				m_streamer.Request(neighbourID);
+				if (drawer)
+				{
+					m_layerTextures.Stage(neighbourID, m_tileWorld.levels[neighbourID]);
+				}
+			});
+		}
 	}
 
 	void LoadLevel(int id, std::variant<int, tako::Vector2> coords)
 	{
+		ScopedSystemTimer timer(m_timings, SystemID::LoadLevel);
 		Player player;
 		RigidBody body{{0, 0}, {0, 0, 12, 16}};
-		Animator animator{&m_playerAnimation, PlayerIdleClip};
-		m_world.IterateComps<Player, RigidBody>([&](Player& pl, RigidBody& rb)
+		if (m_player.IsBound())
 		{
-			player = pl;
-			body = rb;
-		});
+			player = *m_player.Get<Player>(m_world);
+			body = *m_player.Get<RigidBody>(m_world);
+		}
 
 		if (std::holds_alternative<int>(coords))
 		{
@@ -148,29 +277,42 @@ public:
 			player.spawnID = std::get<int>(coords);
 		}
 
+		auto prepared = m_streamer.Take(id);
+		m_commands.Clear();
 		m_world.Reset();
+		m_animation.Clear();
+		m_player.Unbind();
+		m_particles.Clear();
 		auto& level = m_tileWorld.levels[id];
 		m_activeLevel = &level;
 		m_activeLevelID = id;
-		for (int i = 0; i < level.tileLayers.size(); i++)
+		if (drawer)
 		{
-			auto& layer = level.tileLayers[i];
-			if (i >= m_layerCache.size())
-			{
-				auto tex = drawer->CreateTexture(layer.composite);
-				m_layerCache.push_back(tex);
-			}
-			else
-			{
-				drawer->UpdateTexture(m_layerCache[i], layer.composite);
-			}
+			m_activeLayers = &m_layerTextures.Acquire(id, level);
 		}
 
-		for (auto& entDef : level.entities)
+		for (auto& spawn : prepared.spawns)
 		{
-			m_entityInstantiate[entDef.typeName](m_world, entDef);
+			spawn(m_world);
 		}
 
+		// Items the player already owns don't need to exist in the level at all
+		m_world.IterateComps<tako::Entity, Upgrade>([&](tako::Entity entity, Upgrade& up)
+		{
+			if (player.unlocked[up.upgradeID])
+			{
+				m_commands.Delete(entity);
+			}
+		});
+		m_world.IterateComps<tako::Entity, Collectible>([&](tako::Entity entity, Collectible& col)
+		{
+			if (player.collected[col.id])
+			{
+				m_commands.Delete(entity);
+			}
+		});
+		m_commands.Flush(m_world);
+
 		tako::Vector2 spawnPos;
 		if (std::holds_alternative<tako::Vector2>(coords))
 		{
@@ -187,24 +329,56 @@ public:
 			});
 		}
 
-		m_world.Create
+		auto playerEntity = m_world.Create
 		(
 			std::move(player),
-			Position{spawnPos},
+			Position{spawnPos, spawnPos},
 			std::move(body),
 			SpriteRenderer{m_playerAnimation.sprites[0], {0, 1}},
-			std::move(animator),
+			Animator(),
 			Camera()
 		);
+		m_world.GetComponent<Animator>(playerEntity) = m_animation.Add(playerEntity, &m_playerAnimation, PlayerIdleClip);
+		m_player.Bind(playerEntity);
+		m_structureVersion.Bump();
+
+		BuildTriggers();
 	}
 
-	int GetMaxClockTime()
+	// Moves the player to a world space position in whatever level contains it
+	bool TeleportTo(tako::Vector2 worldPos)
 	{
-		ClockMode clockMode;
-		m_world.IterateComps<Player>([&](Player& player)
+		auto id = m_levelIndex.FindLevel(worldPos);
+		if (!id)
 		{
-			clockMode = player.clockMode;
+			return false;
+		}
+		auto& level = m_tileWorld.levels[id.value()];
+		LoadLevel(id.value(), tako::Vector2(worldPos.x - level.worldX, level.worldY + level.size.y - worldPos.y));
+		return true;
+	}
+
+	void BuildTriggers()
+	{
+		std::vector<Trigger> triggers;
+		m_world.IterateComps<tako::Entity, Position, PlayerSpawn>([&](tako::Entity entity, Position& pos, PlayerSpawn& spawn)
+		{
+			triggers.push_back({entity, TriggerType::PlayerSpawn, spawn.id, Rect(pos.position, {TileSize, TileSize})});
 		});
+		m_world.IterateComps<tako::Entity, Position, Upgrade>([&](tako::Entity entity, Position& pos, Upgrade& up)
+		{
+			triggers.push_back({entity, TriggerType::Upgrade, up.upgradeID, Rect(pos.position, {TileSize, TileSize})});
+		});
+		m_world.IterateComps<tako::Entity, Position, Collectible>([&](tako::Entity entity, Position& pos, Collectible& col)
+		{
+			triggers.push_back({entity, TriggerType::Collectible, col.id, Rect(pos.position, {TileSize, TileSize})});
+		});
+		m_triggers.Build(m_activeLevel->size, std::move(triggers));
+	}
+
+	int GetMaxClockTime()
+	{
+		auto clockMode = m_player.IsBound() ? m_player.Get<Player>(m_world)->clockMode : ClockMode::Decimal;
 		switch (clockMode)
 		{
 			case ClockMode::Binary: return 2;
@@ -226,11 +400,7 @@ public:
 
 		char secondDigit;
 
-		ClockMode clockMode;
-		m_world.IterateComps<Player>([&](Player& player)
-		{
-			clockMode = player.clockMode;
-		});
+		auto clockMode = m_player.IsBound() ? m_player.Get<Player>(m_world)->clockMode : ClockMode::Decimal;
 		switch (clockMode)
 		{
 			case ClockMode::Binary:
@@ -271,14 +441,7 @@ public:
 				}
 			} break;
 		}
-		std::stringstream stream;
-		stream << firstDigit << secondDigit;
-		auto str = stream.str();
-		if (str != m_renderedClockText)
-		{
-			UpdateText(drawer, m_font, str, m_clockTex);
-			m_renderedClockText = str;
-		}
+		m_clockDigits = {firstDigit, secondDigit};
 	}
 
 	void UpdateBoxText(FrameData* frameData, float dt)
@@ -298,33 +461,33 @@ public:
 		if (fadeOut || sharedData.textPassed < 0.1f) return;
 		sharedData.textDisplayed++;
 		sharedData.textPassed = 0;
-		auto str = sharedData.targetText.substr(0, sharedData.textDisplayed);
-		UpdateText(drawer, m_font, str, m_dialogTex);
 	}
 
 	void InitAudio()
 	{
-		sharedData.audio->Init();
-		m_music = sharedData.audio->Load("/Music.wav");
-		sharedData.audio->Play(m_music, true);
+		if (sharedData.audio)
+		{
+			sharedData.audio->Init();
+			sharedData.sounds.Load(sharedData.audio);
+			m_music = sharedData.audio->Load("/Music.wav");
+			sharedData.audio->Play(m_music, true);
+		}
 		m_gameState = GameState::Title;
-		UpdateText(drawer, m_font, "Base Clock", m_titleTex);
+		m_titleText = "Base Clock";
 	}
 
 	void Setup(const tako::SetupData& setup)
 	{
 		drawer = new tako::OpenGLPixelArtDrawer(setup.context);
 		context = setup.context;
-		drawer->SetTargetSize(240, 135);
+		drawer->SetTargetSize(TargetWidth, TargetHeight);
 		drawer->AutoScale();
+		m_layerTextures.Init(drawer, LayerTextureBudget);
 		sharedData.audio = setup.audio;
 
-		m_font = new tako::Font("/charmap-cellphone.png", 5, 7, 1, 1, 2, 2,
-			" !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]\a_`abcdefghijklmnopqrstuvwxyz{|}~");
-		m_clockTex = CreateText(drawer, m_font, m_renderedClockText);
-		m_dialogTex = CreateText(drawer, m_font, " ");
-		m_titleTex = CreateText(drawer, m_font, "Press any button");
-		m_promptTex = CreateText(drawer, m_font, "   Press [UP] to  \nactivate the clock");
+		m_text.Init(drawer, "/charmap-cellphone.png",
+			" !\"#$%&'()*+,-./0123456789:;<=>?@ABCDEFGHIJKLMNOPQRSTUVWXYZ[\\]\a_`abcdefghijklmnopqrstuvwxyz{|}~",
+			{5, 7, 1, 1, 7, 9});
 		m_upgradeSprites[0] = drawer->CreateTexture(tako::Bitmap::FromFile("/DashUpgrade.png"));
 		m_upgradeSprites[1] = drawer->CreateTexture(tako::Bitmap::FromFile("/HexClock.png"));
 		m_upgradeSprites[2] = drawer->CreateTexture(tako::Bitmap::FromFile("/HexClock.png"));
@@ -334,58 +497,400 @@ public:
 		auto playerTex = drawer->CreateTexture(tako::Bitmap::FromFile("/Player.png"));
 		m_playerAnimation.InitSprites(drawer, playerTex, 12, 18);
 
+		Profiler::Get().SetEnabled(std::getenv("BASECLOCK_PROFILE") != nullptr);
+		if (auto rate = std::getenv("BASECLOCK_TICK_RATE"))
+		{
+			SetTickRate(std::atof(rate));
+		}
+		if (auto path = std::getenv("BASECLOCK_REPLAY"))
+		{
+			if (!m_replay.Open(path))
+			{
+				LOG("Could not open replay {}", path);
+			}
+		}
+		else if (auto path = std::getenv("BASECLOCK_RECORD"))
+		{
+			if (!m_recorder.Open(path))
+			{
+				LOG("Could not record replay to {}", path);
+			}
+		}
+
+		StartWorkers();
+		RegisterSystems();
+		InitWorld();
+#ifndef NDEBUG
+		m_worldWatcher.Start("/World.ldtk");
+#endif
+	}
 
-		m_tileWorld = tako::Jam::LDtkImporter::LoadWorld("/World.ldtk");
+	// Runs the game without graphics context and audio device, ticked manually through Tick
+	void SetupHeadless()
+	{
+		drawer = nullptr;
+		context = nullptr;
+		sharedData.audio = nullptr;
+		// Sprites can't be created without a drawer, the animator still needs every frame to be addressable
+		m_playerAnimation.sprites.resize(PlayerFrameCount, nullptr);
+		m_playerAnimation.reverse.resize(PlayerFrameCount, nullptr);
+
+		StartWorkers();
+		RegisterSystems();
+		InitWorld();
+	}
+
+	// No workers by default, the scheduled systems are too small to gain from other threads yet and everything runs inline.
+	// BASECLOCK_WORKERS starts that many, at most one less than there are cores since the main thread takes part too.
+	void StartWorkers()
+	{
+		size_t workers = 0;
+		if (auto count = std::getenv("BASECLOCK_WORKERS"))
+		{
+			size_t cores = std::max(std::thread::hardware_concurrency(), 1u);
+			workers = std::min<size_t>(std::max(std::atoi(count), 0), std::min(cores - 1, MaxWorkerThreads));
+		}
+		m_pool.Start(workers);
+	}
+
+	// The graphics update systems, they read their parameters from the members GraphicsUpdate sets
+	void RegisterSystems()
+	{
+		m_scheduler.Add(SystemID::Animation, {Components<Animator>(), Components<SpriteRenderer>()}, [this] { UpdateAnimation(m_graphicsDelta); });
+		m_scheduler.Add(SystemID::CameraFollow, {Components<Position>(), Components<Camera>()}, [this] { UpdateCamera(m_graphicsDelta, m_cameraViewSize); });
+	}
+
+	void InitWorld()
+	{
+		if (!ReadLevelWorld("/World.bclv", m_tileWorld))
+		{
+			LOG("No cooked world found, importing World.ldtk");
+			ImportWorld();
+		}
+		else
+		{
+			BuildSpawnPlans();
+		}
+		m_levelIndex.Build(m_tileWorld);
+#ifndef NDEBUG
+		m_levelHashes = HashLevels(m_tileWorld);
+#endif
 		LoadLevel(0, 0);
 		ResetWorldClock();
 	}
 
-	void GraphicsUpdate(float dt)
+	// Imports and cooks the LDtk project in place, for builds without the cooking step and to pick up edits
+	void ImportWorld()
+	{
+		m_streamer.Clear();
+		m_layerTextures.Clear();
+		auto world = tako::Jam::LDtkImporter::LoadWorld("/World.ldtk");
+		LoadLevelWorld(CookLevelWorld(world), m_tileWorld);
+		BuildSpawnPlans();
+	}
+
+	// Swaps in a reimported world between ticks. Only levels whose content changed lose their textures,
+	// the active level is only rebuilt if it changed and keeps the player where they are.
+	void ApplyWorldReload(WorldReload reload)
 	{
-		m_world.IterateComps<SpriteRenderer, Animator>([&](SpriteRenderer& spr, Animator& animator)
+		m_streamer.Clear();
+		m_layerTextures.ClearStaged();
+		bool typesChanged = reload.world.types.size() != m_tileWorld.types.size();
+		for (size_t i = 0; !typesChanged && i < reload.world.types.size(); i++)
 		{
-			animator.passed += dt;
-			auto frameCount = animator.clip.end - animator.clip.start + 1;
-			auto totalDuration = animator.clip.duration * frameCount;
-			while (animator.passed >= totalDuration)
+			typesChanged = std::strcmp(reload.world.types[i].name, m_tileWorld.types[i].name) != 0;
+		}
+		auto changed = [&](size_t id)
+		{
+			return typesChanged || id >= m_levelHashes.size() || m_levelHashes[id] != reload.levelHashes[id];
+		};
+		size_t changedCount = 0;
+		for (size_t id = 0; id < reload.levelHashes.size(); id++)
+		{
+			if (changed(id))
 			{
-				animator.passed -= totalDuration;
+				m_layerTextures.Invalidate(id);
+				changedCount++;
 			}
-			size_t frame = animator.clip.start + std::floor(animator.passed / animator.clip.duration);
-			spr.sprite = animator.flipX ? animator.data->reverse[frame] : animator.data->sprites[frame];
+		}
+		bool activeChanged = m_activeLevelID >= static_cast<int>(reload.levelHashes.size()) || changed(m_activeLevelID);
+		m_tileWorld = std::move(reload.world);
+		m_levelHashes = std::move(reload.levelHashes);
+		m_levelIndex.Build(m_tileWorld);
+		BuildSpawnPlans();
+		LOG("Reloaded world, {} of {} levels changed", changedCount, m_levelHashes.size());
+
+		if (m_activeLevelID >= static_cast<int>(m_tileWorld.levels.size()))
+		{
+			LoadLevel(0, 0);
+		}
+		else if (activeChanged && m_player.IsBound())
+		{
+			LoadLevel(m_activeLevelID, m_player.Get<Position>(m_world)->position);
+		}
+		else
+		{
+			m_activeLevel = &m_tileWorld.levels[m_activeLevelID];
+		}
+	}
+
+	void SetTimings(SystemTimings* timings)
+	{
+		m_timings = timings;
+	}
+
+	void SetTickRate(float ticksPerSecond)
+	{
+		if (ticksPerSecond > 0)
+		{
+			m_fixedStep = 1 / ticksPerSecond;
+		}
+	}
+
+	void GraphicsUpdate(float dt)
+	{
+		ScopedSystemTimer timer(m_timings, SystemID::GraphicsUpdate);
+		m_graphicsDelta = dt;
+		m_cameraViewSize = drawer ? drawer->GetCameraViewSize() : tako::Vector2(TargetWidth, TargetHeight);
+		m_scheduler.Run(m_pool);
+		if (drawer && m_player.IsBound())
+		{
+			drawer->SetCameraPosition(m_player.Get<Camera>(m_world)->position);
+		}
+	}
+
+	void UpdateAnimation(float dt)
+	{
+		m_pool.ParallelFor(m_animation.GetLength(), AnimationChunkSize, [&](size_t begin, size_t end)
+		{
+			m_animation.Update(m_world, dt, begin, end);
 		});
+	}
+
+	void UpdateCamera(float dt, tako::Vector2 camSize)
+	{
+		if (!m_player.IsBound())
+		{
+			return;
+		}
+		auto& pos = *m_player.Get<Position>(m_world);
+		auto& cam = *m_player.Get<Camera>(m_world);
+		Rect bounds(m_activeLevel->size.x/2, m_activeLevel->size.y/2, m_activeLevel->size.x, m_activeLevel->size.y);
+		auto target = FitMapBound(bounds, pos.position, camSize);
+		if (cam.snapped)
+		{
+			cam.position += (target - cam.position) * dt * 6;
+			cam.position = FitMapBound(bounds, cam.position, camSize);
+		}
+		else
+		{
+			cam.position = target;
+			cam.previous = target;
+			cam.snapped = true;
+		}
+	}
+
 
-		m_world.IterateComps<Position, Camera>([&](Position& pos, Camera& cam)
+	// Runs as many fixed steps as the passed time allows, presses are kept for the next step when none is due
+	void Update(const tako::GameStageData stageData, tako::Input* input, float dt)
+	{
+		// The arena lives behind the FrameData in tako's frame memory, see frameDataSize
+		m_frameArena = FrameArena(reinterpret_cast<tako::U8*>(stageData.frameData) + sizeof(FrameData), FrameArenaSize);
+		m_pendingInput = LatchInput(m_pendingInput, m_inputSampler.Sample(input));
+		m_accumulator = std::min(m_accumulator + dt, m_fixedStep * MaxStepsPerFrame);
+		while (m_accumulator >= m_fixedStep)
 		{
-			auto camSize = drawer->GetCameraViewSize();
-			Rect bounds(m_activeLevel->size.x/2, m_activeLevel->size.y/2, m_activeLevel->size.x, m_activeLevel->size.y);
-			auto target = FitMapBound(bounds, pos.position, camSize);
-			if (cam.snapped)
+			m_accumulator -= m_fixedStep;
+			new (&m_frameData) FrameData();
+			m_frameData.arena = &m_frameArena;
+			Step(m_pendingInput);
+			m_pendingInput = ConsumeInputPresses(m_pendingInput);
+		}
+		m_frameData.interpolation = m_accumulator / m_fixedStep;
+		m_frameData.arena = nullptr;
+		*reinterpret_cast<FrameData*>(stageData.frameData) = m_frameData;
+		if (m_frameArena.HasOverflowed())
+		{
+			LOG("Frame arena of {} bytes overflowed to the heap", FrameArenaSize);
+		}
+#ifdef TAKO_IMGUI
+		DebugUI();
+#endif
+	}
+
+#ifdef TAKO_IMGUI
+	// Once per frame, independent of how many simulation steps ran
+	void DebugUI()
+	{
+		if (m_gameState == GameState::Game && m_player.IsBound())
+		{
+			auto& player = *m_player.Get<Player>(m_world);
+			ImGui::Begin("Debug");
+			ImGui::InputInt("Spawn Map", &player.spawnMap);
+			ImGui::InputInt("Spawner ID", &player.spawnID);
+			ImGui::InputInt("ClockMode", reinterpret_cast<int*>(&player.clockMode));
+
+			ImGui::Checkbox("Dash", &player.unlocked[0]);
+			ImGui::Text("Collected: %d", m_frameData.collectedCount);
+			ImGui::Checkbox("Show collision", &m_showCollision);
+			ImGui::InputFloat2("World Position", &m_teleportTarget.x);
+			if (ImGui::Button("Teleport"))
 			{
-				cam.position += (target - cam.position) * dt * 6;
-				cam.position = FitMapBound(bounds, cam.position, camSize);
+				TeleportTo(m_teleportTarget);
+			}
+			ImGui::End();
+		}
+
+		auto& profiler = Profiler::Get();
+		ImGui::Begin("Profiler");
+		bool enabled = profiler.IsEnabled();
+		if (ImGui::Checkbox("Enabled", &enabled))
+		{
+			profiler.SetEnabled(enabled);
+		}
+		ImGui::SameLine();
+		if (ImGui::Button("Write trace"))
+		{
+			if (!profiler.WriteChromeTrace(ProfilerTraceFile))
+			{
+				LOG("Could not write trace to {}", ProfilerTraceFile);
+			}
+		}
+		std::array<float, 120> durations;
+		for (size_t i = 0; i < static_cast<size_t>(SystemID::Count); i++)
+		{
+			auto count = profiler.GetRecent(static_cast<SystemID>(i), durations.data(), durations.size());
+			float peak = 0;
+			for (size_t d = 0; d < count; d++)
+			{
+				peak = std::max(peak, durations[d]);
+			}
+			ImGui::Text("%s: %.3fms peak", SystemNames[i], peak);
+			ImGui::PlotHistogram(SystemNames[i], durations.data(), count, 0, nullptr, 0, peak);
+		}
+		ImGui::End();
+	}
+#endif
+
+	void Step(const InputState& input)
+	{
+		ReplayFrame frame;
+		frame.input = input;
+		frame.dt = m_fixedStep;
+		if (m_replay.IsOpen())
+		{
+			ReplayFrame recorded;
+			if (m_replay.Next(recorded))
+			{
+				frame = recorded;
 			}
 			else
 			{
-				cam.position = target;
-				cam.snapped = true;
+				LOG("Replay finished after {} frames", m_replay.GetFrame());
 			}
-			drawer->SetCameraPosition(cam.position);
+		}
+		else if (m_recorder.IsOpen())
+		{
+			frame.input = QuantizeInput(frame.input);
+		}
+
+		StoreInterpolationState();
+		Tick(&m_frameData, frame.input, frame.dt);
+
+		// Hashing walks the whole world, only recordings and replays need it
+		if (m_recorder.IsOpen())
+		{
+			frame.hash = HashState();
+			m_recorder.Write(frame);
+		}
+		else if (m_replay.IsOpen() && !m_replayDiverged && HashState() != frame.hash)
+		{
+			LOG("Replay diverged at frame {}", m_replay.GetFrame());
+			m_replayDiverged = true;
+		}
+	}
+
+	void StoreInterpolationState()
+	{
+		m_positions.Each(m_world, [&](Position& pos)
+		{
+			pos.previous = pos.position;
 		});
+		if (auto cam = m_player.Get<Camera>(m_world))
+		{
+			cam->previous = cam->position;
+		}
 	}
 
+	// Hash of the simulation state, cosmetic state like the camera and particles is left out
+	tako::U64 HashState()
+	{
+		StateHasher hasher;
+		hasher.Add(m_gameState);
+		hasher.Add(m_activeLevelID);
+		hasher.Add(m_worldClock);
+		m_world.IterateComps<Position>([&](Position& pos)
+		{
+			hasher.Add(pos.position);
+		});
+		m_world.IterateComps<RigidBody>([&](RigidBody& rb)
+		{
+			hasher.Add(rb.velocity);
+		});
+		m_world.IterateComps<Player>([&](Player& player)
+		{
+			hasher.Add(player.spawnID);
+			hasher.Add(player.spawnMap);
+			hasher.Add(player.airTime);
+			hasher.Add(player.grounded);
+			hasher.Add(player.wasGrounded);
+			hasher.Add(player.dashCooldown);
+			hasher.Add(player.usedDashes);
+			hasher.Add(player.stepCounter);
+			hasher.Add(player.clockMode);
+			for (auto unlocked : player.unlocked)
+			{
+				hasher.Add(unlocked);
+			}
+			for (auto collected : player.collected)
+			{
+				hasher.Add(collected);
+			}
+		});
+		m_world.IterateComps<Animator>([&](Animator& animator)
+		{
+			auto clip = m_animation.GetClip(animator);
+			hasher.Add(clip.start);
+			hasher.Add(clip.end);
+			hasher.Add(m_animation.IsFlippedX(animator));
+			hasher.Add(m_animation.GetPassed(animator));
+		});
+		m_world.IterateComps<PlayerSpawn>([&](PlayerSpawn& spawn)
+		{
+			hasher.Add(spawn.id);
+		});
+		m_world.IterateComps<Upgrade>([&](Upgrade& up)
+		{
+			hasher.Add(up.upgradeID);
+		});
+		m_world.IterateComps<Collectible>([&](Collectible& col)
+		{
+			hasher.Add(col.id);
+		});
+		return hasher.Get();
+	}
 
-	void Update(const tako::GameStageData stageData, tako::Input* input, float dt)
+	void Tick(FrameData* frameData, const InputState& input, float dt)
 	{
 		if (m_gameState == GameState::AudioInit)
 		{
-			if (input->GetAnyDown())
+			if (input.any)
 			{
 				InitAudio();
-				m_world.IterateComps<Player>([&](Player& player)
+				if (m_player.IsBound())
 				{
-					player.grounded = true;
-				});
+					m_player.Get<Player>(m_world)->grounded = true;
+				}
 			}
 			else
 			{
@@ -394,12 +899,7 @@ public:
 		}
 		else if (m_gameState == GameState::Title)
 		{
-			static float prevAxisY = 0;
-			auto axisY = input->GetAxis(tako::Axis::Left).y;
-			auto axisUpDown = axisY > 0.9f && prevAxisY < 0.9f;
-			prevAxisY = axisY;
-
-			if (axisUpDown || input->GetKeyDown(tako::Key::Up) || input->GetKeyDown(tako::Key::W) || input->GetKeyDown(tako::Key::X) || input->GetKeyDown(tako::Key::Gamepad_Dpad_Up) || input->GetKeyDown(tako::Key::Gamepad_B))
+			if (input.up)
 			{
 				m_gameState = GameState::Game;
 			}
@@ -409,40 +909,28 @@ public:
 				return;
 			}
 		}
-		auto frameData = reinterpret_cast<FrameData*>(stageData.frameData);
-#ifdef TAKO_IMGUI
-		m_world.IterateComps<Position, Player>([&](Position& pPos, Player& player)
 		{
-			ImGui::Begin("Debug");
-			ImGui::InputInt("Spawn Map", &player.spawnMap);
-			ImGui::InputInt("Spawner ID", &player.spawnID);
-			ImGui::InputInt("ClockMode", reinterpret_cast<int*>(&player.clockMode));
-
-			ImGui::Checkbox("Dash", &player.unlocked[0]);
-			ImGui::Text("Collected: %d", frameData->collectedCount);
-			ImGui::End();
-		});
-
-#endif
-		UpdateBoxText(frameData, dt);
+			ScopedSystemTimer timer(m_timings, SystemID::UpdateBoxText);
+			UpdateBoxText(frameData, dt);
+		}
 		if (frameData->tutorialDialogOpen)
 		{
 			return;
 		}
 
-		tako::SmallVec<tako::Entity, 4> toDelete;
 		std::optional<int> newNeighbourID;
 #ifndef NDEBUG
-		if (input->GetKeyDown(tako::Key::Enter))
+		if (input.reload)
 		{
-			m_world.IterateComps<Player, Position>([&](Player& player, Position& pos)
-			{
-				m_tileWorld = tako::Jam::LDtkImporter::LoadWorld("/World.ldtk");
-				m_playerWarp = player;
-			});
+			m_worldWatcher.Request();
 			ResetWorldClock();
 		}
+		if (auto reload = m_worldWatcher.Take())
+		{
+			ApplyWorldReload(std::move(reload.value()));
+		}
 #endif // !NDEBUG
+		ScopedSystemTimer transitionTimer(m_timings, SystemID::LevelTransition);
 		if (m_playerWarp)
 		{
 			auto player = m_playerWarp.value();
@@ -452,50 +940,61 @@ public:
 		else
 		{
 			std::optional<tako::Vector2> newPos;
-			m_world.IterateComps<Player, Position>([&](Player& player, Position& pos)
+			if (m_player.IsBound())
 			{
+				auto& pos = *m_player.Get<Position>(m_world);
 				if (pos.position.x < 0 || pos.position.x > m_activeLevel->size.x || pos.position.y < 0 || pos.position.y > m_activeLevel->size.y)
 				{
 					tako::Vector2 worldPos(pos.position.x + m_activeLevel->worldX, m_activeLevel->worldY + m_activeLevel->size.y - pos.position.y);
-					for (auto neighbourID : m_activeLevel->neighbours)
+					newNeighbourID = m_levelIndex.FindLevel(worldPos, m_activeLevelID);
+					if (newNeighbourID)
 					{
-						auto& neighbour = m_tileWorld.levels[neighbourID];
-						if (worldPos.x >= neighbour.worldX && worldPos.x <= neighbour.worldX + neighbour.size.x && worldPos.y >= neighbour.worldY && worldPos.y <= neighbour.worldY + neighbour.size.y )
-						{
-							newPos = tako::Vector2(worldPos.x - neighbour.worldX, neighbour.worldY + neighbour.size.y - worldPos.y);
-							newNeighbourID = neighbourID;
-							break;
-						}
+						auto& neighbour = m_tileWorld.levels[newNeighbourID.value()];
+						newPos = tako::Vector2(worldPos.x - neighbour.worldX, neighbour.worldY + neighbour.size.y - worldPos.y);
 					}
 				}
-			});
+			}
 			if (newPos)
 			{
 				LoadLevel(newNeighbourID.value(), newPos.value());
 			}
 		}
-		PlayerUpdate(&sharedData, frameData, input, dt, m_world, m_activeLevelID);
+		PrefetchNeighbours();
+		transitionTimer.Stop();
 
-		m_nodesCache.clear();
-		m_world.IterateComps<tako::Entity, Position, RigidBody>([&](tako::Entity entity, Position& pos, RigidBody& body)
 		{
-			m_nodesCache.push_back
-			({
-				pos.position,
-				body.velocity,
-				body.bounds,
-				nullptr,
-				{0, 0}
-			});
-		});
+			ScopedSystemTimer timer(m_timings, SystemID::PlayerUpdate);
+			PlayerUpdate(&sharedData, frameData, input, dt, m_world, m_playerQuery, m_commands, m_animation, m_triggers, m_particles, m_activeLevelID);
+		}
+		// Sync point, physics iterates the world next
+		FlushCommands();
 
-		tako::Jam::PlatformerPhysics2D::CalculateMovement(dt, m_nodesCache);
-		tako::Jam::PlatformerPhysics2D::SimulatePhysics(m_nodesCache, {m_activeLevel->collision, {16, 16}, (int) m_activeLevel->size.x / 16, (int) m_activeLevel->size.y / 16 }, [](auto& self, auto& other) { LOG("col!");});
-		m_world.IterateComps<Player, RigidBody>([&](Player& player, RigidBody& rb)
 		{
-			player.grounded = rb.velocity.y == 0 && (player.grounded || player.prevYVelocity < 0);
-			player.prevYVelocity = rb.velocity.y;
-		});
+			ScopedSystemTimer timer(m_timings, SystemID::CalculateMovement);
+			CalculateMovement(dt, m_world, m_movementQuery);
+		}
+		{
+			ScopedSystemTimer timer(m_timings, SystemID::SimulatePhysics);
+			TileCollision collision{m_activeLevel->solidRows, m_activeLevel->solidRowWords, m_activeLevel->collisionWidth, m_activeLevel->collisionHeight};
+			m_contacts.Clear();
+			SimulatePhysics(m_world, m_bodyQuery, collision, m_bodyBoundsCache, m_contacts);
+		}
+		// Grounded while something below pushes back up
+		if (m_player.IsBound())
+		{
+			auto entity = m_player.GetEntity();
+			auto& player = *m_player.Get<Player>(m_world);
+			player.grounded = false;
+			for (auto& contact : m_contacts)
+			{
+				bool below = contact.self == entity ? contact.normal.y > 0 : !contact.tile && contact.other == entity && contact.normal.y < 0;
+				if (below)
+				{
+					player.grounded = true;
+				}
+			}
+		}
+		ScopedSystemTimer clockTimer(m_timings, SystemID::Clock);
 		m_worldClock -= dt;
 		if (frameData->triggeredCheckpoint)
 		{
@@ -505,9 +1004,11 @@ public:
 		if (m_worldClock <= 0)
 		{
 			ResetWorldClock();
-			sharedData.audio->Play("/Reset.wav");
-			m_world.IterateComps<Position, Player>([&](Position& pPos, Player& player)
+			sharedData.PlaySound(Sound::Reset);
+			if (m_player.IsBound())
 			{
+				auto& pPos = *m_player.Get<Position>(m_world);
+				auto& player = *m_player.Get<Player>(m_world);
 				if (m_activeLevelID != player.spawnMap)
 				{
 					m_playerWarp = player;
@@ -519,73 +1020,63 @@ public:
 						if (player.spawnID == spawn.id)
 						{
 							pPos.position = pos.position;
+							pPos.previous = pos.position;
 							player.grounded = true;
 						}
 					});
 				}
-			});
+			}
 
 		}
+		clockTimer.Stop();
 
-		m_world.IterateComps<tako::Entity, SpriteRenderer, FadeOut>([&](tako::Entity ent, SpriteRenderer& spr, FadeOut& fade)
-		{
-			fade.left -= dt;
-			if (fade.left <= 0)
-			{
-				toDelete.Push(ent);
-				return;
-			}
-			spr.alpha = fade.left / fade.duration * fade.startFade;
-		});
+		m_particles.Update(dt);
 
-		UpdateClockText();
-		for (int i = 0; i < toDelete.GetLength(); i++)
 		{
-			m_world.Delete(toDelete[i]);
+			ScopedSystemTimer timer(m_timings, SystemID::UpdateClockText);
+			UpdateClockText();
 		}
 		GraphicsUpdate(dt);
 	}
 
-	void DrawEntities()
+	// Cached queries rebuild themselves on the next walk after this
+	void FlushCommands()
 	{
-		m_world.IterateComps<Position, RectRenderer>([&](Position& pos, RectRenderer& ren)
+		if (!m_commands.IsEmpty())
 		{
-			drawer->DrawRectangle(pos.position.x - ren.size.x / 2, pos.position.y + ren.size.y / 2, ren.size.x, ren.size.y, ren.color);
+			m_commands.Flush(m_world);
+			m_structureVersion.Bump();
+		}
+	}
+
+	void DrawEntities(float interpolation)
+	{
+		ScopedSystemTimer timer(nullptr, SystemID::DrawEntities);
+		m_rectQuery.Each(m_world, [&](Position& pos, RectRenderer& ren)
+		{
+			m_spriteBatch.AddRectangle(Interpolate(pos.previous, pos.position, interpolation), ren);
 		});
-		m_world.IterateComps<Position, SpriteRenderer>([&](Position& pos, SpriteRenderer& ren)
+		m_spriteQuery.Each(m_world, [&](Position& pos, SpriteRenderer& ren)
 		{
-			float width;
-			float height;
-			if (std::holds_alternative<tako::Texture>(ren.sprite))
-			{
-				auto tex = std::get<tako::Texture>(ren.sprite);
-				width = tex.width;
-				height = tex.height;
-			}
-			else
-			{
-				auto tex = std::get<tako::OpenGLSprite*>(ren.sprite);
-				width = tex->width;
-				height = tex->height;
-			}
-			float x = pos.position.x + ren.offset.x - width / 2;
-			float y = pos.position.y + ren.offset.y + height / 2;
-			if (std::holds_alternative<tako::Texture>(ren.sprite))
-			{
-				auto tex = std::get<tako::Texture>(ren.sprite);
-				drawer->DrawImage(x, y, width, height, tex.handle);
-			}
-			else
+			m_spriteBatch.AddSprite(Interpolate(pos.previous, pos.position, interpolation), ren);
+		});
+		m_particles.Draw(m_spriteBatch, interpolation);
+		if (m_showCollision)
+		{
+			for (auto& solid : m_activeLevel->solidRects)
 			{
-				auto sprite = std::get<tako::OpenGLSprite*>(ren.sprite);
-				drawer->DrawSprite(x, y, width, height, sprite, {255, 255, 255, ren.alpha});
+				tako::Vector2 size(solid.width * TileSize, solid.height * TileSize);
+				tako::Vector2 center(solid.x * TileSize + size.x / 2, solid.y * TileSize + size.y / 2);
+				m_spriteBatch.AddRectangle(center, {size, {255, 0, 0, 96}});
 			}
-		});
+		}
+		m_spriteBatch.Submit(drawer);
 	}
 
 	void DrawTileLayer(int i)
 	{
-		auto& tex = m_layerCache[i];
+		ScopedSystemTimer timer(nullptr, SystemID::DrawTileLayer);
+		auto& tex = (*m_activeLayers)[i];
 		drawer->DrawImage(0, tex.height, tex.width, tex.height, tex.handle);
 	}
 
@@ -597,50 +1088,55 @@ public:
 			drawer->SetClearColor({0, 0, 0, 255});
 			drawer->Clear();
 			drawer->SetCameraPosition({0 , 0});
-			drawer->DrawImage((float) -m_titleTex.width / 2, (float) m_titleTex.height / 2, m_titleTex.width, m_titleTex.height, m_titleTex.handle);
+			m_text.DrawCentered(m_spriteBatch, m_titleText, 0, m_text.Measure(m_titleText).y / 2);
+			m_spriteBatch.Submit(drawer);
 			return;
 		}
+		// Here rather than in Tick, which can run several times a frame
+		m_layerTextures.UploadStaged(LayerUploadBytesPerFrame);
 		auto frameData = reinterpret_cast<FrameData*>(stageData.frameData);
-		m_world.IterateComps<Camera>([&](Camera& cam)
+		if (auto cam = m_player.Get<Camera>(m_world))
 		{
-			drawer->SetCameraPosition(cam.position);
-		});
+			drawer->SetCameraPosition(Interpolate(cam->previous, cam->position, frameData->interpolation));
+		}
 		drawer->SetClearColor(m_activeLevel->backgroundColor);
 		drawer->Clear();
 
 		if (m_activeLevel->entityLayerIndex < 0)
 		{
-			DrawEntities();
+			DrawEntities(frameData->interpolation);
 		}
 		for (int i = 0; i < m_activeLevel->tileLayers.size(); i++)
 		{
 			DrawTileLayer(i);
 			if (m_activeLevel->entityLayerIndex == i)
 			{
-				DrawEntities();
+				DrawEntities(frameData->interpolation);
 			}
 		}
 
 		drawer->SetCameraPosition({0 , 0});
 		if (m_gameState == GameState::Title)
 		{
-			drawer->DrawImage((float) -m_titleTex.width, 42, m_titleTex.width * 2, m_titleTex.height * 2, m_titleTex.handle);
-			drawer->DrawImage((float) -m_promptTex.width / 2, (float) m_promptTex.height / 2, m_promptTex.width, m_promptTex.height, m_promptTex.handle);
+			m_text.DrawCentered(m_spriteBatch, m_titleText, 0, 42, 2);
+			m_text.DrawCentered(m_spriteBatch, PromptText, 0, m_text.Measure(PromptText).y / 2);
 		}
 		else
 		{
-			drawer->DrawImage((float) -m_clockTex.width / 2, 42, m_clockTex.width, m_clockTex.height, m_clockTex.handle);
+			m_text.DrawCentered(m_spriteBatch, std::string_view(m_clockDigits.data(), m_clockDigits.size()), 0, 42);
 			if (frameData->showDialog)
 			{
-				float x = (float) -m_dialogTex.width / 2;
+				// The box grows with the revealed text
+				std::string_view text = sharedData.targetText;
+				auto size = m_text.Measure(text.substr(0, sharedData.textDisplayed));
+				float x = -size.x / 2;
 				float y = 0;
-				float width = m_dialogTex.width;
-				float height = m_dialogTex.height;
 				constexpr const float padding = 4;
-				drawer->DrawRectangle(x - padding / 2, y + padding / 2, width + padding, height + padding, {0, 0, 0, 255});
-				drawer->DrawImage(x, y, width, height, m_dialogTex.handle);
+				drawer->DrawRectangle(x - padding / 2, y + padding / 2, size.x + padding, size.y + padding, {0, 0, 0, 255});
+				m_text.Draw(m_spriteBatch, text, x, y, 1, sharedData.textDisplayed);
 			}
 		}
+		m_spriteBatch.Submit(drawer);
 
 	}
 
@@ -648,25 +1144,67 @@ private:
 	tako::OpenGLPixelArtDrawer* drawer;
 	tako::GraphicsContext* context;
 	tako::World m_world;
-	tako::Jam::TileWorld m_tileWorld;
-	tako::Jam::TileMap* m_activeLevel;
+	LevelWorld m_tileWorld;
+	LevelIndex m_levelIndex;
+	Level* m_activeLevel;
 	int m_activeLevelID;
 	float m_worldClock;
-	std::vector<tako::Texture> m_layerCache;
-	std::vector<tako::Jam::PlatformerPhysics2D::Node> m_nodesCache;
-	std::map<std::string, std::function<tako::Entity(tako::World&, tako::Jam::TileEntity&)>> m_entityInstantiate;
-
-	tako::Font* m_font;
-	std::string m_renderedClockText = "10";
-	tako::Texture m_clockTex;
-	tako::Texture m_titleTex;
-	tako::Texture m_promptTex;
-	tako::Texture m_dialogTex;
+	LayerTextureCache m_layerTextures;
+	const std::vector<tako::Texture>* m_activeLayers;
+	std::vector<BodyBounds> m_bodyBoundsCache;
+	ContactBuffer m_contacts;
+	TriggerGrid m_triggers;
+	// Carries the Player and Camera
+	Singleton m_player;
+	SpriteBatch m_spriteBatch;
+	ParticlePool m_particles;
+	// Draws the merged solid rects of the level over it, toggled in the debug window
+	bool m_showCollision = false;
+	tako::Vector2 m_teleportTarget;
+	struct EntityRegistration
+	{
+		const tako::Reflection::StructInformation* info;
+		SpawnPrepare prepare;
+	};
+	std::map<std::string, EntityRegistration> m_entityTypes;
+	std::vector<SpawnPlan> m_spawnPlans;
+
+	TextRenderer m_text;
+	std::array<char, 2> m_clockDigits = {'1', '0'};
+	std::string_view m_titleText = "Press any button";
 	tako::Texture m_collectibleSprite;
 	AnimationData m_playerAnimation;
 	std::array<tako::Texture, 3> m_upgradeSprites;
 	std::optional<Player> m_playerWarp;
+	InputSampler m_inputSampler;
+	InputState m_pendingInput;
+	float m_fixedStep = 1 / DefaultTickRate;
+	float m_accumulator = 0;
+	FrameData m_frameData;
+	FrameArena m_frameArena;
+	CommandBuffer m_commands{&m_frameArena};
+	// Bumped by LoadLevel and FlushCommands, the only places the world's structure changes
+	StructureVersion m_structureVersion;
+	CachedQuery<Position> m_positions{&m_structureVersion};
+	PlayerQuery m_playerQuery{&m_structureVersion};
+	MovementQuery m_movementQuery{&m_structureVersion};
+	BodyQuery m_bodyQuery{&m_structureVersion};
+	CachedQuery<Position, RectRenderer> m_rectQuery{&m_structureVersion};
+	CachedQuery<Position, SpriteRenderer> m_spriteQuery{&m_structureVersion};
+	ReplayRecorder m_recorder;
+	ReplayPlayer m_replay;
+	bool m_replayDiverged = false;
+	SystemTimings* m_timings = nullptr;
 	tako::AudioClip* m_music;
 	SharedData sharedData;
 	GameState m_gameState = GameState::AudioInit;
+	std::vector<tako::U64> m_levelHashes;
+	WorldWatcher m_worldWatcher;
+	AnimationSystem m_animation;
+	SystemScheduler m_scheduler;
+	float m_graphicsDelta = 0;
+	tako::Vector2 m_cameraViewSize;
+	ThreadPool m_pool;
+	// Declared last so the streaming thread is stopped before the data it reads is destroyed
+	LevelStreamer m_streamer;
 };
@@ -0,0 +1,75 @@
+#pragma once
+#include <Input.hpp>
+#include <Math.hpp>
+
+// Gameplay relevant input of a single frame, sampled once so the simulation doesn't need a live tako::Input
+struct InputState
+{
+	float moveX = 0;
+	bool jump = false;
+	bool dash = false;
+	bool up = false;
+	bool toggleClock = false;
+	bool reload = false;
+	bool any = false;
+};
+
+// Presses sampled on frames without a simulation step are kept until the next step consumes them
+inline InputState LatchInput(const InputState& pending, const InputState& sampled)
+{
+	InputState state = sampled;
+	state.dash |= pending.dash;
+	state.up |= pending.up;
+	state.toggleClock |= pending.toggleClock;
+	state.reload |= pending.reload;
+	state.any |= pending.any;
+	return state;
+}
+
+inline InputState ConsumeInputPresses(InputState state)
+{
+	state.dash = false;
+	state.up = false;
+	state.toggleClock = false;
+	state.reload = false;
+	state.any = false;
+	return state;
+}
+
+class InputSampler
+{
+public:
+	InputState Sample(tako::Input* input)
+	{
+		InputState state;
+		state.moveX = input->GetAxis(tako::Axis::Left).x;
+		if (std::abs(state.moveX) < 0.1f)
+		{
+			state.moveX = 0;
+		}
+		if (input->GetKey(tako::Key::Left) || input->GetKey(tako::Key::A) || input->GetKey(tako::Key::Gamepad_Dpad_Left))
+		{
+			state.moveX -= 1;
+		}
+		if (input->GetKey(tako::Key::Right) || input->GetKey(tako::Key::D) || input->GetKey(tako::Key::Gamepad_Dpad_Right))
+		{
+			state.moveX += 1;
+		}
+		state.moveX = tako::mathf::clamp(state.moveX, -1, 1);
+
+		state.jump = input->GetKey(tako::Key::Space) || input->GetKey(tako::Key::Gamepad_A);
+		state.dash = input->GetKeyDown(tako::Key::C) || input->GetKeyDown(tako::Key::Gamepad_X) || input->GetKeyDown(tako::Key::Gamepad_R2) || input ->GetKeyDown(tako::Key::Gamepad_R);
+
+		auto axisY = input->GetAxis(tako::Axis::Left).y;
+		auto axisUpDown = axisY > 0.9f && m_prevAxisY < 0.9f;
+		m_prevAxisY = axisY;
+		state.up = axisUpDown || input->GetKeyDown(tako::Key::Up) || input->GetKeyDown(tako::Key::W) || input->GetKeyDown(tako::Key::X) || input->GetKeyDown(tako::Key::Gamepad_Dpad_Up) || input->GetKeyDown(tako::Key::Gamepad_B);
+
+		state.toggleClock = input->GetKeyDown(tako::Key::B);
+		state.reload = input->GetKeyDown(tako::Key::Enter);
+		state.any = input->GetAnyDown();
+		return state;
+	}
+private:
+	float m_prevAxisY = 0;
+};
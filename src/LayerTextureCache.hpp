@@ -0,0 +1,185 @@
+#pragma once
+#include <OpenGLPixelArtDrawer.hpp>
+#include <Texture.hpp>
+#include <algorithm>
+#include <deque>
+#include <list>
+#include <vector>
+#include "LevelData.hpp"
+
+// Keeps the tile layer textures of recently visited levels resident, the textures of the least recently used
+// levels are deleted once the budget is exceeded. Levels that are about to be entered can be staged,
+// their layers are then uploaded a few at a time across frames instead of all at once on the transition.
+class LayerTextureCache
+{
+public:
+	void Init(tako::OpenGLPixelArtDrawer* drawer, size_t budget)
+	{
+		m_drawer = drawer;
+		m_budget = budget;
+	}
+
+	// Textures of all layers of the level, uploads whatever isn't resident yet
+	const std::vector<tako::Texture>& Acquire(int levelID, const Level& level)
+	{
+		auto& entry = Touch(levelID);
+		while (entry.textures.size() < level.tileLayers.size())
+		{
+			UploadNext(entry, level);
+		}
+		m_pinned = levelID;
+		Evict();
+		return entry.textures;
+	}
+
+	void Stage(int levelID, const Level& level)
+	{
+		for (auto& staged : m_staged)
+		{
+			if (staged.levelID == levelID)
+			{
+				return;
+			}
+		}
+		auto entry = Find(levelID);
+		if (entry != m_entries.end() && entry->textures.size() == level.tileLayers.size())
+		{
+			return;
+		}
+		m_staged.push_back({levelID, &level});
+	}
+
+	// Call once per rendered frame, the budget is per call
+	void UploadStaged(size_t maxBytes)
+	{
+		size_t uploaded = 0;
+		while (!m_staged.empty() && uploaded < maxBytes)
+		{
+			auto staged = m_staged.front();
+			auto& entry = Touch(staged.levelID);
+			if (entry.textures.size() >= staged.level->tileLayers.size())
+			{
+				m_staged.pop_front();
+				continue;
+			}
+			uploaded += UploadNext(entry, *staged.level);
+		}
+		Evict();
+	}
+
+	// Forgets the textures of a level whose layers changed
+	void Invalidate(int levelID)
+	{
+		auto entry = Find(levelID);
+		if (entry != m_entries.end())
+		{
+			Release(*entry);
+			m_entries.erase(entry);
+		}
+	}
+
+	// Staged levels point into the level data, they have to be dropped before it is replaced
+	void ClearStaged()
+	{
+		m_staged.clear();
+	}
+
+	// Deletes the textures of all levels
+	void Clear()
+	{
+		for (auto& entry : m_entries)
+		{
+			Release(entry);
+		}
+		m_entries.clear();
+		m_staged.clear();
+		m_pinned = -1;
+	}
+private:
+	struct Entry
+	{
+		int levelID;
+		std::vector<tako::Texture> textures;
+	};
+
+	struct Staged
+	{
+		int levelID;
+		const Level* level;
+	};
+
+	tako::OpenGLPixelArtDrawer* m_drawer = nullptr;
+	size_t m_budget = 0;
+	size_t m_residentBytes = 0;
+	int m_pinned = -1;
+	// Most recently used first
+	std::list<Entry> m_entries;
+	std::deque<Staged> m_staged;
+
+	std::list<Entry>::iterator Find(int levelID)
+	{
+		for (auto it = m_entries.begin(); it != m_entries.end(); it++)
+		{
+			if (it->levelID == levelID)
+			{
+				return it;
+			}
+		}
+		return m_entries.end();
+	}
+
+	Entry& Touch(int levelID)
+	{
+		auto it = Find(levelID);
+		if (it == m_entries.end())
+		{
+			m_entries.push_front({levelID});
+		}
+		else
+		{
+			m_entries.splice(m_entries.begin(), m_entries, it);
+		}
+		return m_entries.front();
+	}
+
+	size_t UploadNext(Entry& entry, const Level& level)
+	{
+		auto& composite = level.tileLayers[entry.textures.size()].composite;
+		entry.textures.push_back(m_drawer->CreateTexture(composite));
+		auto bytes = GetBytes(entry.textures.back());
+		m_residentBytes += bytes;
+		return bytes;
+	}
+
+	static size_t GetBytes(const tako::Texture& tex)
+	{
+		return sizeof(tako::Color) * tex.width * tex.height;
+	}
+
+	void Release(Entry& entry)
+	{
+		for (auto& tex : entry.textures)
+		{
+			m_residentBytes -= GetBytes(tex);
+			m_drawer->DeleteTexture(tex);
+		}
+		entry.textures.clear();
+	}
+
+	// Evicts the least recently used levels until the resident textures fit the budget again
+	void Evict()
+	{
+		auto it = m_entries.end();
+		while (m_residentBytes > m_budget && it != m_entries.begin())
+		{
+			it--;
+			if (it->levelID == m_pinned)
+			{
+				continue;
+			}
+			m_staged.erase(std::remove_if(m_staged.begin(), m_staged.end(), [&](const Staged& staged) { return staged.levelID == it->levelID; }), m_staged.end());
+			Release(*it);
+			it = m_entries.erase(it);
+		}
+	}
+};
@@ -0,0 +1,30 @@
+#include <Tako.hpp>
+#include <Jam/LDtkImporter.hpp>
+#include <fstream>
+#include "LevelData.hpp"
+
+// Build step, cooks an LDtk project into the binary level format the game loads.
+// The project is given by its asset path, the way the game imports it, the output by a native path.
+int main(int argc, char* argv[])
+{
+	if (argc < 3)
+	{
+		LOG("Usage: LevelCooker <asset path of the world.ldtk> <output>");
+		return 1;
+	}
+	if (tako::FileSystem::GetFileSize(argv[1]) == 0)
+	{
+		LOG("Could not find the asset {}", argv[1]);
+		return 1;
+	}
+	auto world = tako::Jam::LDtkImporter::LoadWorld(argv[1]);
+	auto data = CookLevelWorld(world);
+	std::ofstream file(argv[2], std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!file)
+	{
+		LOG("Could not write {}", argv[2]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,517 @@
+#pragma once
+#include <Math.hpp>
+#include <FileSystem.hpp>
+#include <Jam/TileMap.hpp>
+#include <Bitmap.hpp>
+#include <Utility.hpp>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+// Cooked level file, written by the LevelCooker at build time.
+// Every section is referenced by its byte offset from the start of the file and 8 byte aligned,
+// so the loaded (or mapped) file is used in place and nothing has to be parsed.
+constexpr const char LevelFileMagic[4] = {'B', 'C', 'L', 'V'};
+constexpr const tako::U32 LevelFileVersion = 4;
+// Edge length of a tile in pixels, for collision, triggers and everything else on the level grid
+constexpr const int TileSize = 16;
+
+enum class LevelFieldType : tako::U32
+{
+	Int,
+	Bool
+};
+
+struct LevelFileHeader
+{
+	char magic[4];
+	tako::U32 version;
+	tako::U32 levelCount;
+	tako::U32 levelOffset;
+	tako::U32 typeCount;
+	tako::U32 typeOffset;
+};
+
+// Entity types are interned at cook time, entities refer to them by index
+struct LevelFileType
+{
+	tako::U32 nameOffset;
+	tako::U32 fieldCount;
+	tako::U32 fieldOffset;
+};
+
+struct LevelFileField
+{
+	tako::U32 nameOffset;
+	LevelFieldType type;
+};
+
+struct LevelFileLevel
+{
+	tako::I32 worldX;
+	tako::I32 worldY;
+	float width;
+	float height;
+	tako::Color backgroundColor;
+	tako::I32 entityLayerIndex;
+	tako::U32 neighbourCount;
+	tako::U32 neighbourOffset;
+	// Size of the collision grid in tiles
+	tako::U32 collisionWidth;
+	tako::U32 collisionHeight;
+	tako::U32 layerCount;
+	tako::U32 layerOffset;
+	tako::U32 entityCount;
+	tako::U32 entityOffset;
+	// The solid tiles one bit each, rows padded to whole words and starting with the bottom row
+	tako::U32 solidRowWords;
+	tako::U32 solidRowOffset;
+	tako::U32 solidRectCount;
+	tako::U32 solidRectOffset;
+};
+
+// Solid tiles merged into rectangles, in tiles from the bottom left of the level
+struct SolidRect
+{
+	tako::U16 x;
+	tako::U16 y;
+	tako::U16 width;
+	tako::U16 height;
+};
+
+struct LevelFileLayer
+{
+	tako::U32 width;
+	tako::U32 height;
+	tako::U32 pixelOffset;
+};
+
+// Followed by one value per field of its type, in the order of the type's fields
+struct LevelFileEntity
+{
+	float x;
+	float y;
+	tako::U32 typeID;
+	tako::U32 valueOffset;
+};
+
+static_assert(sizeof(tako::Color) == 4);
+
+template<typename T>
+struct ArrayView
+{
+	const T* data = nullptr;
+	size_t count = 0;
+
+	const T* begin() const { return data; }
+	const T* end() const { return data + count; }
+	size_t size() const { return count; }
+	const T& operator[](size_t i) const { return data[i]; }
+};
+
+struct LevelLayer
+{
+	tako::ImageView composite;
+};
+
+struct LevelEntityType
+{
+	const char* name;
+	std::vector<std::pair<const char*, LevelFieldType>> fields;
+};
+
+struct LevelEntity
+{
+	tako::U32 typeID;
+	tako::Vector2 position;
+	ArrayView<tako::I32> values;
+};
+
+struct Level
+{
+	tako::Vector2 size;
+	int worldX;
+	int worldY;
+	tako::Color backgroundColor;
+	int entityLayerIndex;
+	ArrayView<tako::I32> neighbours;
+	int collisionWidth;
+	int collisionHeight;
+	ArrayView<tako::U64> solidRows;
+	int solidRowWords;
+	ArrayView<SolidRect> solidRects;
+	std::vector<LevelLayer> tileLayers;
+	std::vector<LevelEntity> entities;
+};
+
+struct LevelWorld
+{
+	// The cooked data the levels view into
+	std::vector<tako::U8> data;
+	std::vector<LevelEntityType> types;
+	std::vector<Level> levels;
+};
+
+namespace LevelCooking
+{
+	inline tako::U32 Append(std::vector<tako::U8>& out, const void* data, size_t size)
+	{
+		out.resize((out.size() + 7) & ~size_t(7));
+		auto offset = out.size();
+		out.resize(offset + size);
+		if (size > 0)
+		{
+			std::memcpy(out.data() + offset, data, size);
+		}
+		return static_cast<tako::U32>(offset);
+	}
+
+	inline tako::U32 AppendString(std::vector<tako::U8>& out, const std::string& str)
+	{
+		return Append(out, str.c_str(), str.size() + 1);
+	}
+
+	// Rows of the imported grid are stored top first, y is counted from the bottom
+	inline bool IsCookedSolid(const std::vector<tako::U8>& collision, int width, int height, int x, int y)
+	{
+		return collision[(height - 1 - y) * width + x];
+	}
+
+	inline std::vector<tako::U64> PackSolidRows(const std::vector<tako::U8>& collision, int width, int height, int rowWords)
+	{
+		std::vector<tako::U64> rows(rowWords * height, 0);
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				if (IsCookedSolid(collision, width, height, x, y))
+				{
+					rows[y * rowWords + x / 64] |= tako::U64(1) << (x % 64);
+				}
+			}
+		}
+		return rows;
+	}
+
+	// Greedy, grows every uncovered solid tile to the widest run and then up as long as the rows above match
+	inline std::vector<SolidRect> MergeSolidRects(const std::vector<tako::U8>& collision, int width, int height)
+	{
+		std::vector<SolidRect> rects;
+		std::vector<bool> covered(collision.size(), false);
+		auto isFree = [&](int x, int y)
+		{
+			return IsCookedSolid(collision, width, height, x, y) && !covered[y * width + x];
+		};
+		for (int y = 0; y < height; y++)
+		{
+			for (int x = 0; x < width; x++)
+			{
+				if (!isFree(x, y))
+				{
+					continue;
+				}
+				int w = 1;
+				while (x + w < width && isFree(x + w, y))
+				{
+					w++;
+				}
+				int h = 1;
+				while (y + h < height)
+				{
+					bool fits = true;
+					for (int cx = x; cx < x + w && fits; cx++)
+					{
+						fits = isFree(cx, y + h);
+					}
+					if (!fits)
+					{
+						break;
+					}
+					h++;
+				}
+				for (int cy = y; cy < y + h; cy++)
+				{
+					for (int cx = x; cx < x + w; cx++)
+					{
+						covered[cy * width + cx] = true;
+					}
+				}
+				rects.push_back({static_cast<tako::U16>(x), static_cast<tako::U16>(y), static_cast<tako::U16>(w), static_cast<tako::U16>(h)});
+			}
+		}
+		return rects;
+	}
+}
+
+inline std::vector<tako::U8> CookLevelWorld(tako::Jam::TileWorld& world)
+{
+	using namespace LevelCooking;
+	std::vector<tako::U8> out;
+	LevelFileHeader header;
+	std::memcpy(header.magic, LevelFileMagic, sizeof(header.magic));
+	header.version = LevelFileVersion;
+	header.levelCount = world.levels.size();
+	Append(out, &header, sizeof(header));
+	std::vector<LevelFileLevel> levels(world.levels.size());
+	header.levelOffset = Append(out, levels.data(), levels.size() * sizeof(LevelFileLevel));
+
+	// LDtk lists the field instances of every entity in the order of its definition, the first entity of a type defines its layout
+	std::map<std::string, tako::U32> typeIDs;
+	std::vector<std::vector<std::pair<std::string, LevelFieldType>>> typeFields;
+	std::vector<std::string> typeNames;
+	auto internType = [&](tako::Jam::TileEntity& entDef)
+	{
+		auto it = typeIDs.find(entDef.typeName);
+		if (it != typeIDs.end())
+		{
+			return it->second;
+		}
+		tako::U32 id = typeNames.size();
+		typeIDs[entDef.typeName] = id;
+		typeNames.push_back(entDef.typeName);
+		auto& fields = typeFields.emplace_back();
+		for (auto& field : entDef.fields)
+		{
+			if (field["__type"] == "Int")
+			{
+				fields.emplace_back(field["__identifier"].get<std::string>(), LevelFieldType::Int);
+			}
+			else if (field["__type"] == "Bool")
+			{
+				fields.emplace_back(field["__identifier"].get<std::string>(), LevelFieldType::Bool);
+			}
+		}
+		return id;
+	};
+
+	for (size_t i = 0; i < world.levels.size(); i++)
+	{
+		auto& map = world.levels[i];
+		auto& level = levels[i];
+		level.worldX = map.worldX;
+		level.worldY = map.worldY;
+		level.width = map.size.x;
+		level.height = map.size.y;
+		level.backgroundColor = map.backgroundColor;
+		level.entityLayerIndex = map.entityLayerIndex;
+
+		std::vector<tako::I32> neighbours(map.neighbours.begin(), map.neighbours.end());
+		level.neighbourCount = neighbours.size();
+		level.neighbourOffset = Append(out, neighbours.data(), neighbours.size() * sizeof(tako::I32));
+
+		int collisionWidth = map.size.x / TileSize;
+		int collisionHeight = map.size.y / TileSize;
+		level.collisionWidth = collisionWidth;
+		level.collisionHeight = collisionHeight;
+		// Only used to build the rows and rectangles from, the byte grid isn't stored
+		std::vector<tako::U8> collision(map.collision.size());
+		for (size_t c = 0; c < collision.size(); c++)
+		{
+			collision[c] = map.collision[c] ? 1 : 0;
+		}
+		level.solidRowWords = (collisionWidth + 63) / 64;
+		auto solidRows = PackSolidRows(collision, collisionWidth, collisionHeight, level.solidRowWords);
+		level.solidRowOffset = Append(out, solidRows.data(), solidRows.size() * sizeof(tako::U64));
+		auto solidRects = MergeSolidRects(collision, collisionWidth, collisionHeight);
+		level.solidRectCount = solidRects.size();
+		level.solidRectOffset = Append(out, solidRects.data(), solidRects.size() * sizeof(SolidRect));
+
+		std::vector<LevelFileLayer> layers(map.tileLayers.size());
+		for (size_t l = 0; l < layers.size(); l++)
+		{
+			auto& bitmap = map.tileLayers[l].composite;
+			layers[l].width = bitmap.Width();
+			layers[l].height = bitmap.Height();
+			layers[l].pixelOffset = Append(out, bitmap.GetData(), sizeof(tako::Color) * bitmap.Width() * bitmap.Height());
+		}
+		level.layerCount = layers.size();
+		level.layerOffset = Append(out, layers.data(), layers.size() * sizeof(LevelFileLayer));
+
+		std::vector<LevelFileEntity> entities(map.entities.size());
+		for (size_t e = 0; e < entities.size(); e++)
+		{
+			auto& entDef = map.entities[e];
+			auto typeID = internType(entDef);
+			auto& fields = typeFields[typeID];
+			std::vector<tako::I32> values(fields.size(), 0);
+			for (auto& field : entDef.fields)
+			{
+				for (size_t f = 0; f < fields.size(); f++)
+				{
+					if (field["__identifier"].get<std::string>() != fields[f].first)
+					{
+						continue;
+					}
+					values[f] = fields[f].second == LevelFieldType::Bool ? field["__value"].get<bool>() : field["__value"].get<int>();
+				}
+			}
+			entities[e].x = entDef.position.x;
+			entities[e].y = entDef.position.y;
+			entities[e].typeID = typeID;
+			entities[e].valueOffset = Append(out, values.data(), values.size() * sizeof(tako::I32));
+		}
+		level.entityCount = entities.size();
+		level.entityOffset = Append(out, entities.data(), entities.size() * sizeof(LevelFileEntity));
+	}
+
+	std::vector<LevelFileType> types(typeNames.size());
+	for (size_t t = 0; t < types.size(); t++)
+	{
+		std::vector<LevelFileField> fields;
+		for (auto& [name, type] : typeFields[t])
+		{
+			fields.push_back({AppendString(out, name), type});
+		}
+		types[t].nameOffset = AppendString(out, typeNames[t]);
+		types[t].fieldCount = fields.size();
+		types[t].fieldOffset = Append(out, fields.data(), fields.size() * sizeof(LevelFileField));
+	}
+	header.typeCount = types.size();
+	header.typeOffset = Append(out, types.data(), types.size() * sizeof(LevelFileType));
+
+	std::memcpy(out.data(), &header, sizeof(header));
+	std::memcpy(out.data() + header.levelOffset, levels.data(), levels.size() * sizeof(LevelFileLevel));
+	return out;
+}
+
+// Bounds checked views into cooked data. A section that doesn't lie within the data marks the whole file as invalid,
+// so a stale or truncated file is rejected instead of read out of bounds.
+struct LevelFileReader
+{
+	ArrayView<tako::U8> data;
+	bool valid = true;
+
+	template<typename T>
+	ArrayView<T> Get(tako::U32 offset, size_t count)
+	{
+		if (offset % alignof(T) != 0 || offset > data.size() || count > (data.size() - offset) / sizeof(T))
+		{
+			valid = false;
+			return {};
+		}
+		return {reinterpret_cast<const T*>(data.data + offset), count};
+	}
+
+	const char* GetString(tako::U32 offset)
+	{
+		if (offset >= data.size() || !std::memchr(data.data + offset, 0, data.size() - offset))
+		{
+			valid = false;
+			return "";
+		}
+		return reinterpret_cast<const char*>(data.data + offset);
+	}
+};
+
+// Sets up views into cooked data that stays alive as long as the world, the data has to be 8 byte aligned.
+// The world is left untouched if the data is invalid.
+inline bool LoadLevelWorldView(ArrayView<tako::U8> data, LevelWorld& world)
+{
+	LevelFileHeader header;
+	if (data.size() < sizeof(header))
+	{
+		return false;
+	}
+	std::memcpy(&header, data.data, sizeof(header));
+	if (std::memcmp(header.magic, LevelFileMagic, sizeof(header.magic)) != 0 || header.version != LevelFileVersion)
+	{
+		return false;
+	}
+
+	LevelFileReader reader{data};
+	std::vector<LevelEntityType> types;
+	for (auto& type : reader.Get<LevelFileType>(header.typeOffset, header.typeCount))
+	{
+		auto& entityType = types.emplace_back();
+		entityType.name = reader.GetString(type.nameOffset);
+		for (auto& field : reader.Get<LevelFileField>(type.fieldOffset, type.fieldCount))
+		{
+			entityType.fields.emplace_back(reader.GetString(field.nameOffset), field.type);
+		}
+	}
+
+	auto cookedLevels = reader.Get<LevelFileLevel>(header.levelOffset, header.levelCount);
+	std::vector<Level> levels(cookedLevels.size());
+	for (size_t i = 0; i < cookedLevels.size() && reader.valid; i++)
+	{
+		auto& cooked = cookedLevels[i];
+		auto& level = levels[i];
+		level.size = tako::Vector2(cooked.width, cooked.height);
+		level.worldX = cooked.worldX;
+		level.worldY = cooked.worldY;
+		level.backgroundColor = cooked.backgroundColor;
+		level.entityLayerIndex = cooked.entityLayerIndex;
+		level.neighbours = reader.Get<tako::I32>(cooked.neighbourOffset, cooked.neighbourCount);
+		for (auto neighbour : level.neighbours)
+		{
+			reader.valid &= neighbour >= 0 && static_cast<tako::U32>(neighbour) < header.levelCount;
+		}
+
+		level.collisionWidth = cooked.collisionWidth;
+		level.collisionHeight = cooked.collisionHeight;
+		reader.valid &= cooked.solidRowWords == (cooked.collisionWidth + 63) / 64;
+		level.solidRows = reader.Get<tako::U64>(cooked.solidRowOffset, size_t(cooked.solidRowWords) * cooked.collisionHeight);
+		level.solidRowWords = cooked.solidRowWords;
+		level.solidRects = reader.Get<SolidRect>(cooked.solidRectOffset, cooked.solidRectCount);
+
+		for (auto& layer : reader.Get<LevelFileLayer>(cooked.layerOffset, cooked.layerCount))
+		{
+			auto pixels = reader.Get<tako::Color>(layer.pixelOffset, size_t(layer.width) * layer.height);
+			level.tileLayers.push_back({tako::ImageView(pixels.data, layer.width, layer.height)});
+		}
+
+		for (auto& entity : reader.Get<LevelFileEntity>(cooked.entityOffset, cooked.entityCount))
+		{
+			if (entity.typeID >= types.size())
+			{
+				reader.valid = false;
+				break;
+			}
+			level.entities.push_back
+			({
+				entity.typeID,
+				tako::Vector2(entity.x, entity.y),
+				reader.Get<tako::I32>(entity.valueOffset, types[entity.typeID].fields.size())
+			});
+		}
+	}
+	if (!reader.valid)
+	{
+		LOG("Cooked level data is corrupted or out of date");
+		return false;
+	}
+
+	world.types = std::move(types);
+	world.levels = std::move(levels);
+	return true;
+}
+
+// The world takes ownership of the cooked data
+inline bool LoadLevelWorld(std::vector<tako::U8> data, LevelWorld& world)
+{
+	std::vector<tako::U8> previous = std::move(world.data);
+	world.data = std::move(data);
+	if (!LoadLevelWorldView({world.data.data(), world.data.size()}, world))
+	{
+		world.data = std::move(previous);
+		return false;
+	}
+	return true;
+}
+
+inline bool ReadLevelWorld(const char* file, LevelWorld& world)
+{
+	auto size = tako::FileSystem::GetFileSize(file);
+	if (size == 0)
+	{
+		return false;
+	}
+	std::vector<tako::U8> data(size);
+	size_t bytesRead;
+	if (!tako::FileSystem::ReadFile(file, data.data(), data.size(), bytesRead) || bytesRead != size)
+	{
+		return false;
+	}
+	return LoadLevelWorld(std::move(data), world);
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include <Math.hpp>
+#include <algorithm>
+#include <array>
+#include <optional>
+#include <vector>
+#include "LevelData.hpp"
+
+// Bounding volume hierarchy over the world space bounds of all levels, rebuilt whenever a world is loaded.
+// World space is LDtk's, y grows downwards. Borders count as inside, like for the level transitions.
+class LevelIndex
+{
+public:
+	void Build(const LevelWorld& world)
+	{
+		m_nodes.clear();
+		m_levels.clear();
+		m_bounds.clear();
+		for (size_t i = 0; i < world.levels.size(); i++)
+		{
+			auto& level = world.levels[i];
+			m_bounds.push_back({static_cast<float>(level.worldX), static_cast<float>(level.worldY), level.worldX + level.size.x, level.worldY + level.size.y});
+			m_levels.push_back(i);
+		}
+		if (!m_levels.empty())
+		{
+			BuildNode(0, m_levels.size());
+		}
+	}
+
+	// Lowest ID of the levels containing the point, apart from the excluded one
+	std::optional<int> FindLevel(tako::Vector2 point, int exclude = -1) const
+	{
+		std::optional<int> found;
+		QueryRect(point, point, [&](int id)
+		{
+			if (id != exclude && (!found || id < found.value()))
+			{
+				found = id;
+			}
+		});
+		return found;
+	}
+
+	// Calls back with the ID of every level overlapping the rect
+	template<typename Cb>
+	void QueryRect(tako::Vector2 min, tako::Vector2 max, Cb&& callback) const
+	{
+		if (m_nodes.empty())
+		{
+			return;
+		}
+		Bounds query{min.x, min.y, max.x, max.y};
+		std::array<tako::U32, 64> stack;
+		size_t depth = 0;
+		stack[depth++] = 0;
+		while (depth > 0)
+		{
+			auto nodeIndex = stack[--depth];
+			auto& node = m_nodes[nodeIndex];
+			if (!node.bounds.Overlaps(query))
+			{
+				continue;
+			}
+			if (node.count > 0)
+			{
+				for (auto i = node.start; i < node.start + node.count; i++)
+				{
+					if (m_bounds[m_levels[i]].Overlaps(query))
+					{
+						callback(m_levels[i]);
+					}
+				}
+			}
+			else
+			{
+				stack[depth++] = node.right;
+				stack[depth++] = nodeIndex + 1;
+			}
+		}
+	}
+private:
+	struct Bounds
+	{
+		float minX;
+		float minY;
+		float maxX;
+		float maxY;
+
+		bool Overlaps(const Bounds& other) const
+		{
+			return minX <= other.maxX && other.minX <= maxX && minY <= other.maxY && other.minY <= maxY;
+		}
+	};
+
+	// Leaves hold a range of m_levels, inner nodes have their left child right behind them
+	struct Node
+	{
+		Bounds bounds;
+		tako::U32 start;
+		tako::U32 count;
+		tako::U32 right;
+	};
+
+	static constexpr size_t LeafSize = 4;
+
+	std::vector<Node> m_nodes;
+	std::vector<int> m_levels;
+	std::vector<Bounds> m_bounds;
+
+	// Splits at the median of the level centers along the longer axis
+	tako::U32 BuildNode(size_t begin, size_t end)
+	{
+		auto index = static_cast<tako::U32>(m_nodes.size());
+		Bounds bounds = m_bounds[m_levels[begin]];
+		Bounds centers{bounds.maxX, bounds.maxY, bounds.minX, bounds.minY};
+		for (auto i = begin; i < end; i++)
+		{
+			auto& level = m_bounds[m_levels[i]];
+			bounds = {std::min(bounds.minX, level.minX), std::min(bounds.minY, level.minY), std::max(bounds.maxX, level.maxX), std::max(bounds.maxY, level.maxY)};
+			float x = (level.minX + level.maxX) / 2;
+			float y = (level.minY + level.maxY) / 2;
+			centers = {std::min(centers.minX, x), std::min(centers.minY, y), std::max(centers.maxX, x), std::max(centers.maxY, y)};
+		}
+		m_nodes.push_back({bounds, static_cast<tako::U32>(begin), static_cast<tako::U32>(end - begin), 0});
+		if (end - begin <= LeafSize)
+		{
+			return index;
+		}
+
+		bool splitX = centers.maxX - centers.minX >= centers.maxY - centers.minY;
+		auto mid = begin + (end - begin) / 2;
+		std::nth_element(m_levels.begin() + begin, m_levels.begin() + mid, m_levels.begin() + end, [&](int a, int b)
+		{
+			auto& boundsA = m_bounds[a];
+			auto& boundsB = m_bounds[b];
+			return splitX ? boundsA.minX + boundsA.maxX < boundsB.minX + boundsB.maxX : boundsA.minY + boundsA.maxY < boundsB.minY + boundsB.maxY;
+		});
+		m_nodes[index].count = 0;
+		BuildNode(begin, mid);
+		auto right = BuildNode(mid, end);
+		m_nodes[index].right = right;
+		return index;
+	}
+};
@@ -0,0 +1,135 @@
+#pragma once
+#include <World.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+#include "LevelData.hpp"
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define LEVEL_STREAMER_THREADED 0
+#else
+#define LEVEL_STREAMER_THREADED 1
+#endif
+
+using EntitySpawn = std::function<tako::Entity(tako::World&)>;
+
+// Everything LoadLevel needs that doesn't touch the world or the GPU
+struct PreparedLevel
+{
+	int id;
+	std::vector<EntitySpawn> spawns;
+};
+
+// Prepares levels on a worker thread ahead of the transition into them
+class LevelStreamer
+{
+public:
+	using PrepareCallback = std::function<PreparedLevel(int)>;
+
+	~LevelStreamer()
+	{
+#if LEVEL_STREAMER_THREADED
+		if (m_worker.joinable())
+		{
+			{
+				std::lock_guard lock(m_mutex);
+				m_stop = true;
+			}
+			m_condition.notify_all();
+			m_worker.join();
+		}
+#endif
+	}
+
+	void Init(PrepareCallback prepare)
+	{
+		m_prepare = std::move(prepare);
+#if LEVEL_STREAMER_THREADED
+		m_worker = std::thread([this] { Work(); });
+#endif
+	}
+
+	void Request(int id)
+	{
+#if LEVEL_STREAMER_THREADED
+		{
+			std::lock_guard lock(m_mutex);
+			if (m_ready.count(id) > 0 || m_working == id || std::find(m_queue.begin(), m_queue.end(), id) != m_queue.end())
+			{
+				return;
+			}
+			m_queue.push_back(id);
+		}
+		m_condition.notify_all();
+#endif
+	}
+
+	// Hands out the prepared level, waits for it if it's currently being worked on and prepares it in place if it wasn't requested
+	PreparedLevel Take(int id)
+	{
+#if LEVEL_STREAMER_THREADED
+		std::unique_lock lock(m_mutex);
+		m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), id), m_queue.end());
+		m_condition.wait(lock, [&] { return m_working != id; });
+		auto it = m_ready.find(id);
+		if (it != m_ready.end())
+		{
+			auto level = std::move(it->second);
+			m_ready.erase(it);
+			return level;
+		}
+		lock.unlock();
+#endif
+		return m_prepare(id);
+	}
+
+	// Drops all prepared levels, has to be called before the level data they're based on changes
+	void Clear()
+	{
+#if LEVEL_STREAMER_THREADED
+		std::unique_lock lock(m_mutex);
+		m_queue.clear();
+		m_condition.wait(lock, [&] { return m_working < 0; });
+		m_ready.clear();
+#endif
+	}
+private:
+	PrepareCallback m_prepare;
+#if LEVEL_STREAMER_THREADED
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<int> m_queue;
+	std::map<int, PreparedLevel> m_ready;
+	int m_working = -1;
+	bool m_stop = false;
+
+	void Work()
+	{
+		std::unique_lock lock(m_mutex);
+		while (true)
+		{
+			m_condition.wait(lock, [&] { return m_stop || !m_queue.empty(); });
+			if (m_stop)
+			{
+				return;
+			}
+			auto id = m_queue.front();
+			m_queue.pop_front();
+			m_working = id;
+			lock.unlock();
+			auto level = m_prepare(id);
+			lock.lock();
+			m_ready[id] = std::move(level);
+			m_working = -1;
+			m_condition.notify_all();
+		}
+	}
+#endif
+};
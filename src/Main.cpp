@@ -31,5 +31,5 @@ void tako::InitTakoConfig(GameConfig& config)
 	config.graphicsAPI = tako::GraphicsAPI::OpenGL;
 	config.initAudioDelayed = true;
 	config.gameDataSize = sizeof(Game);
-	config.frameDataSize = sizeof(FrameData);
+	config.frameDataSize = sizeof(FrameData) + FrameArenaSize;
 }
@@ -0,0 +1,87 @@
+#pragma once
+#include <Math.hpp>
+#include <array>
+#include "Comps.hpp"
+#include "SpriteBatch.hpp"
+
+struct Particle
+{
+	tako::Vector2 position;
+	tako::Vector2 previous;
+	tako::Vector2 velocity;
+	SpriteRenderer renderer;
+	float duration;
+	float left;
+	tako::U8 startAlpha;
+};
+
+// Cosmetic particles like the dash afterimages, kept out of the ECS.
+// Stored in a ring in the order they were emitted, when full the oldest particle is replaced.
+class ParticlePool
+{
+public:
+	static constexpr size_t Capacity = 512;
+
+	void Emit(tako::Vector2 position, tako::Vector2 velocity, const SpriteRenderer& renderer, float duration, tako::U8 startAlpha)
+	{
+		if (m_count == Capacity)
+		{
+			m_start = (m_start + 1) % Capacity;
+			m_count--;
+		}
+		auto& particle = m_particles[(m_start + m_count) % Capacity];
+		particle.position = position;
+		particle.previous = position;
+		particle.velocity = velocity;
+		particle.renderer = renderer;
+		particle.duration = duration;
+		particle.left = duration;
+		particle.startAlpha = startAlpha;
+		m_count++;
+	}
+
+	void Update(float dt)
+	{
+		for (size_t i = 0; i < m_count; i++)
+		{
+			auto& particle = m_particles[(m_start + i) % Capacity];
+			particle.left -= dt;
+			particle.previous = particle.position;
+			particle.position += particle.velocity * dt;
+			particle.renderer.alpha = particle.left > 0 ? particle.left / particle.duration * particle.startAlpha : 0;
+		}
+		// Expired particles in front can be dropped right away, the ones behind a living particle once it expires
+		while (m_count > 0 && m_particles[m_start].left <= 0)
+		{
+			m_start = (m_start + 1) % Capacity;
+			m_count--;
+		}
+	}
+
+	void Draw(SpriteBatch& batch, float interpolation)
+	{
+		for (size_t i = 0; i < m_count; i++)
+		{
+			auto& particle = m_particles[(m_start + i) % Capacity];
+			if (particle.left > 0)
+			{
+				batch.AddSprite(particle.previous + (particle.position - particle.previous) * interpolation, particle.renderer);
+			}
+		}
+	}
+
+	void Clear()
+	{
+		m_start = 0;
+		m_count = 0;
+	}
+
+	size_t GetLength() const
+	{
+		return m_count;
+	}
+private:
+	std::array<Particle, Capacity> m_particles;
+	size_t m_start = 0;
+	size_t m_count = 0;
+};
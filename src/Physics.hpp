@@ -0,0 +1,298 @@
+#pragma once
+#include <World.hpp>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <optional>
+#include <vector>
+#include "Comps.hpp"
+#include "LevelData.hpp"
+#include "Query.hpp"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+inline int LowestBit(tako::U64 bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, bits);
+	return index;
+#else
+	return __builtin_ctzll(bits);
+#endif
+}
+
+inline int HighestBit(tako::U64 bits)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, bits);
+	return index;
+#else
+	return 63 - __builtin_clzll(bits);
+#endif
+}
+
+// Solid tiles of a level, one bit per tile and rows padded to whole words, starting with the bottom row like the game's coordinates.
+// Everything outside the level is open.
+struct TileCollision
+{
+	ArrayView<tako::U64> rows;
+	int rowWords;
+	int width;
+	int height;
+
+	bool IsSolid(int x, int y) const
+	{
+		if (x < 0 || y < 0 || x >= width || y >= height)
+		{
+			return false;
+		}
+		return (rows[y * rowWords + x / 64] >> (x % 64)) & 1;
+	}
+
+	bool IsRowSolid(int y, int columnStart, int columnEnd) const
+	{
+		columnStart = std::max(columnStart, 0);
+		columnEnd = std::min(columnEnd, width - 1);
+		if (y < 0 || y >= height || columnStart > columnEnd)
+		{
+			return false;
+		}
+		auto row = rows.data + y * rowWords;
+		for (int word = columnStart / 64; word <= columnEnd / 64; word++)
+		{
+			if (row[word] & ColumnMask(word, columnStart, columnEnd))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Lowest column (or highest with last) within the range that is solid in any of the rows
+	std::optional<int> FindSolidColumn(int rowStart, int rowEnd, int columnStart, int columnEnd, bool last) const
+	{
+		rowStart = std::max(rowStart, 0);
+		rowEnd = std::min(rowEnd, height - 1);
+		columnStart = std::max(columnStart, 0);
+		columnEnd = std::min(columnEnd, width - 1);
+		if (rowStart > rowEnd || columnStart > columnEnd)
+		{
+			return {};
+		}
+		int firstWord = columnStart / 64;
+		int lastWord = columnEnd / 64;
+		for (int i = 0; i <= lastWord - firstWord; i++)
+		{
+			int word = last ? lastWord - i : firstWord + i;
+			tako::U64 bits = 0;
+			for (int y = rowStart; y <= rowEnd; y++)
+			{
+				bits |= rows[y * rowWords + word];
+			}
+			bits &= ColumnMask(word, columnStart, columnEnd);
+			if (bits)
+			{
+				return word * 64 + (last ? HighestBit(bits) : LowestBit(bits));
+			}
+		}
+		return {};
+	}
+private:
+	// Bits of the word that lie within the columns
+	static tako::U64 ColumnMask(int word, int columnStart, int columnEnd)
+	{
+		int low = std::max(columnStart - word * 64, 0);
+		int high = std::min(columnEnd - word * 64, 63);
+		return (~tako::U64(0) >> (63 - high)) & (~tako::U64(0) << low);
+	}
+};
+
+inline int TileStart(float coord)
+{
+	return std::floor(coord / TileSize);
+}
+
+inline int TileEnd(float coord)
+{
+	return static_cast<int>(std::ceil(coord / TileSize)) - 1;
+}
+
+// Moves the rect by dx, stopping flush against the first solid column in the way.
+// Returns how much of the movement got cut off, 0 if nothing was in the way.
+inline float SweepX(const TileCollision& map, Rect& rect, float dx)
+{
+	int rowStart = TileStart(rect.Bottom());
+	int rowEnd = TileEnd(rect.Top());
+	auto start = rect.x;
+	if (dx > 0)
+	{
+		if (auto x = map.FindSolidColumn(rowStart, rowEnd, TileEnd(rect.Right()) + 1, TileEnd(rect.Right() + dx), false))
+		{
+			rect.x = x.value() * TileSize - rect.w / 2;
+			return dx - (rect.x - start);
+		}
+	}
+	else if (dx < 0)
+	{
+		if (auto x = map.FindSolidColumn(rowStart, rowEnd, TileStart(rect.Left() + dx), TileStart(rect.Left()) - 1, true))
+		{
+			rect.x = (x.value() + 1) * TileSize + rect.w / 2;
+			return (rect.x - start) - dx;
+		}
+	}
+	rect.x += dx;
+	return 0;
+}
+
+inline float SweepY(const TileCollision& map, Rect& rect, float dy)
+{
+	int columnStart = TileStart(rect.Left());
+	int columnEnd = TileEnd(rect.Right());
+	auto start = rect.y;
+	if (dy > 0)
+	{
+		for (int y = TileEnd(rect.Top()) + 1; y <= TileEnd(rect.Top() + dy); y++)
+		{
+			if (map.IsRowSolid(y, columnStart, columnEnd))
+			{
+				rect.y = y * TileSize - rect.h / 2;
+				return dy - (rect.y - start);
+			}
+		}
+	}
+	else if (dy < 0)
+	{
+		for (int y = TileStart(rect.Bottom()) - 1; y >= TileStart(rect.Bottom() + dy); y--)
+		{
+			if (map.IsRowSolid(y, columnStart, columnEnd))
+			{
+				rect.y = (y + 1) * TileSize + rect.h / 2;
+				return (rect.y - start) - dy;
+			}
+		}
+	}
+	rect.y += dy;
+	return 0;
+}
+
+struct Contact
+{
+	tako::Entity self;
+	// Only set for contacts between two bodies
+	tako::Entity other;
+	// Points from whatever was hit towards self
+	tako::Vector2 normal;
+	float penetration;
+	bool tile;
+};
+
+// Written by SimulatePhysics every frame for the gameplay systems to read, contacts past the capacity are dropped
+class ContactBuffer
+{
+public:
+	void Clear()
+	{
+		m_count = 0;
+	}
+
+	void Add(const Contact& contact)
+	{
+		if (m_count < m_contacts.size())
+		{
+			m_contacts[m_count++] = contact;
+		}
+	}
+
+	const Contact* begin() const
+	{
+		return m_contacts.data();
+	}
+
+	const Contact* end() const
+	{
+		return m_contacts.data() + m_count;
+	}
+
+	size_t GetLength() const
+	{
+		return m_count;
+	}
+private:
+	std::array<Contact, 256> m_contacts;
+	size_t m_count = 0;
+};
+
+struct BodyBounds
+{
+	tako::Entity entity;
+	Rect rect;
+};
+
+// Separates along the axis with the smaller overlap
+inline Contact BodyContact(const BodyBounds& self, const BodyBounds& other)
+{
+	auto overlapX = std::min(self.rect.Right(), other.rect.Right()) - std::max(self.rect.Left(), other.rect.Left());
+	auto overlapY = std::min(self.rect.Top(), other.rect.Top()) - std::max(self.rect.Bottom(), other.rect.Bottom());
+	Contact contact{self.entity, other.entity};
+	if (overlapX < overlapY)
+	{
+		contact.normal = tako::Vector2(self.rect.x < other.rect.x ? -1 : 1, 0);
+		contact.penetration = overlapX;
+	}
+	else
+	{
+		contact.normal = tako::Vector2(0, self.rect.y < other.rect.y ? -1 : 1);
+		contact.penetration = overlapY;
+	}
+	contact.tile = false;
+	return contact;
+}
+
+using MovementQuery = CachedQuery<RigidBody>;
+using BodyQuery = CachedQuery<tako::Entity, Position, RigidBody>;
+
+inline void CalculateMovement(float dt, tako::World& world, MovementQuery& bodies)
+{
+	bodies.Each(world, [&](RigidBody& body)
+	{
+		body.movement = body.velocity * dt;
+	});
+}
+
+// Moves all bodies in place in the component storage, resolving against the tiles axis by axis.
+// Overlapping bodies are found by sweeping over the bounds sorted by their left edge.
+inline void SimulatePhysics(tako::World& world, BodyQuery& bodies, const TileCollision& map, std::vector<BodyBounds>& boundsCache, ContactBuffer& contacts)
+{
+	boundsCache.clear();
+	bodies.Each(world, [&](tako::Entity entity, Position& pos, RigidBody& body)
+	{
+		auto rect = body.CalcRec(pos.position);
+		if (auto cut = SweepX(map, rect, body.movement.x); cut != 0)
+		{
+			body.velocity.x = 0;
+			contacts.Add({entity, {}, tako::Vector2(body.movement.x > 0 ? -1 : 1, 0), std::abs(cut), true});
+		}
+		if (auto cut = SweepY(map, rect, body.movement.y); cut != 0)
+		{
+			body.velocity.y = 0;
+			contacts.Add({entity, {}, tako::Vector2(0, body.movement.y > 0 ? -1 : 1), std::abs(cut), true});
+		}
+		pos.position = tako::Vector2(rect.x - body.bounds.x, rect.y - body.bounds.y);
+		boundsCache.push_back({entity, rect});
+	});
+
+	std::sort(boundsCache.begin(), boundsCache.end(), [](const BodyBounds& a, const BodyBounds& b) { return a.rect.Left() < b.rect.Left(); });
+	for (size_t i = 0; i < boundsCache.size(); i++)
+	{
+		for (size_t j = i + 1; j < boundsCache.size() && boundsCache[j].rect.Left() <= boundsCache[i].rect.Right(); j++)
+		{
+			if (Rect::Overlap(boundsCache[i].rect, boundsCache[j].rect))
+			{
+				contacts.Add(BodyContact(boundsCache[i], boundsCache[j]));
+			}
+		}
+	}
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include <World.hpp>
+#include <tuple>
+#include <vector>
+
+// Counts structural changes to the world, anything that creates, deletes or changes the components of an entity bumps it
+class StructureVersion
+{
+public:
+	void Bump()
+	{
+		m_value++;
+	}
+
+	tako::U64 Get() const
+	{
+		return m_value;
+	}
+private:
+	tako::U64 m_value = 1;
+};
+
+// Components are cached by pointer, the entity itself by value
+template<typename C>
+struct QuerySlot
+{
+	using Type = C*;
+
+	static Type Store(C& comp)
+	{
+		return &comp;
+	}
+
+	static C& Load(Type slot)
+	{
+		return *slot;
+	}
+};
+
+template<>
+struct QuerySlot<tako::Entity>
+{
+	using Type = tako::Entity;
+
+	static Type Store(tako::Entity entity)
+	{
+		return entity;
+	}
+
+	static tako::Entity Load(Type slot)
+	{
+		return slot;
+	}
+};
+
+// Remembers what an IterateComps over Cs matched and walks that list until the structure version changes.
+// Components don't move between structural changes, so the cached pointers stay valid until the next bump.
+template<typename... Cs>
+class CachedQuery
+{
+public:
+	explicit CachedQuery(const StructureVersion* version) : m_version(version)
+	{
+	}
+
+	template<typename Cb>
+	void Each(tako::World& world, Cb&& cb)
+	{
+		Refresh(world);
+		for (auto& row : m_rows)
+		{
+			std::apply([&](typename QuerySlot<Cs>::Type... slots)
+			{
+				cb(QuerySlot<Cs>::Load(slots)...);
+			}, row);
+		}
+	}
+
+	size_t Size(tako::World& world)
+	{
+		Refresh(world);
+		return m_rows.size();
+	}
+private:
+	const StructureVersion* m_version;
+	tako::U64 m_builtVersion = 0;
+	std::vector<std::tuple<typename QuerySlot<Cs>::Type...>> m_rows;
+
+	void Refresh(tako::World& world)
+	{
+		if (m_builtVersion == m_version->Get())
+		{
+			return;
+		}
+		m_rows.clear();
+		world.IterateComps<Cs...>([&](auto&&... comps)
+		{
+			m_rows.emplace_back(QuerySlot<Cs>::Store(comps)...);
+		});
+		m_builtVersion = m_version->Get();
+	}
+};
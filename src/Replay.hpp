@@ -0,0 +1,182 @@
+#pragma once
+#include <Math.hpp>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include "InputState.hpp"
+
+// Replay file: 4 byte magic + version, followed by fixed size frames until the end of the file.
+// Every frame stores the input that was fed into Game::Tick, its dt and the hash of the state after the tick.
+constexpr const char ReplayMagic[4] = {'B', 'C', 'R', 'P'};
+constexpr const tako::U32 ReplayVersion = 1;
+constexpr const size_t ReplayFrameSize = 14;
+
+struct ReplayFrame
+{
+	InputState input;
+	float dt = 0;
+	tako::U64 hash = 0;
+};
+
+namespace ReplayButton
+{
+	constexpr tako::U8 Jump = 1 << 0;
+	constexpr tako::U8 Dash = 1 << 1;
+	constexpr tako::U8 Up = 1 << 2;
+	constexpr tako::U8 ToggleClock = 1 << 3;
+	constexpr tako::U8 Reload = 1 << 4;
+	constexpr tako::U8 Any = 1 << 5;
+}
+
+inline std::array<tako::U8, ReplayFrameSize> EncodeReplayFrame(const ReplayFrame& frame)
+{
+	std::array<tako::U8, ReplayFrameSize> data;
+	auto& input = frame.input;
+	data[0] =
+		(input.jump ? ReplayButton::Jump : 0) |
+		(input.dash ? ReplayButton::Dash : 0) |
+		(input.up ? ReplayButton::Up : 0) |
+		(input.toggleClock ? ReplayButton::ToggleClock : 0) |
+		(input.reload ? ReplayButton::Reload : 0) |
+		(input.any ? ReplayButton::Any : 0);
+	data[1] = static_cast<tako::U8>(static_cast<tako::I8>(std::round(tako::mathf::clamp(input.moveX, -1, 1) * 127)));
+	std::memcpy(&data[2], &frame.dt, sizeof(float));
+	std::memcpy(&data[6], &frame.hash, sizeof(tako::U64));
+	return data;
+}
+
+inline ReplayFrame DecodeReplayFrame(const tako::U8* data)
+{
+	ReplayFrame frame;
+	auto& input = frame.input;
+	input.jump = data[0] & ReplayButton::Jump;
+	input.dash = data[0] & ReplayButton::Dash;
+	input.up = data[0] & ReplayButton::Up;
+	input.toggleClock = data[0] & ReplayButton::ToggleClock;
+	input.reload = data[0] & ReplayButton::Reload;
+	input.any = data[0] & ReplayButton::Any;
+	input.moveX = static_cast<tako::I8>(data[1]) / 127.0f;
+	std::memcpy(&frame.dt, &data[2], sizeof(float));
+	std::memcpy(&frame.hash, &data[6], sizeof(tako::U64));
+	return frame;
+}
+
+// Rounds the input to what a replay can represent, so a recorded run simulates exactly what gets played back
+inline InputState QuantizeInput(const InputState& input)
+{
+	ReplayFrame frame;
+	frame.input = input;
+	return DecodeReplayFrame(EncodeReplayFrame(frame).data()).input;
+}
+
+class ReplayRecorder
+{
+public:
+	bool Open(const char* path)
+	{
+		m_file.open(path, std::ios::binary | std::ios::trunc);
+		if (!m_file)
+		{
+			return false;
+		}
+		m_file.write(ReplayMagic, sizeof(ReplayMagic));
+		m_file.write(reinterpret_cast<const char*>(&ReplayVersion), sizeof(ReplayVersion));
+		return true;
+	}
+
+	bool IsOpen() const
+	{
+		return m_file.is_open();
+	}
+
+	void Write(const ReplayFrame& frame)
+	{
+		auto data = EncodeReplayFrame(frame);
+		m_file.write(reinterpret_cast<const char*>(data.data()), data.size());
+		// The game is never shut down orderly, keep the file usable if it gets killed
+		if (++m_framesWritten % 64 == 0)
+		{
+			m_file.flush();
+		}
+	}
+private:
+	std::ofstream m_file;
+	size_t m_framesWritten = 0;
+};
+
+class ReplayPlayer
+{
+public:
+	bool Open(const char* path)
+	{
+		m_file.open(path, std::ios::binary);
+		char magic[sizeof(ReplayMagic)];
+		tako::U32 version;
+		m_file.read(magic, sizeof(magic));
+		m_file.read(reinterpret_cast<char*>(&version), sizeof(version));
+		if (!m_file || std::memcmp(magic, ReplayMagic, sizeof(magic)) != 0 || version != ReplayVersion)
+		{
+			m_file.close();
+			return false;
+		}
+		m_frame = 0;
+		return true;
+	}
+
+	bool IsOpen() const
+	{
+		return m_file.is_open();
+	}
+
+	bool Next(ReplayFrame& frame)
+	{
+		std::array<tako::U8, ReplayFrameSize> data;
+		if (!m_file.read(reinterpret_cast<char*>(data.data()), data.size()))
+		{
+			m_file.close();
+			return false;
+		}
+		frame = DecodeReplayFrame(data.data());
+		m_frame++;
+		return true;
+	}
+
+	size_t GetFrame() const
+	{
+		return m_frame;
+	}
+private:
+	std::ifstream m_file;
+	size_t m_frame = 0;
+};
+
+// FNV-1a over the simulation state, used to detect a replay diverging from its recording
+class StateHasher
+{
+public:
+	template<typename T>
+	void Add(const T& value)
+	{
+		static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>);
+		auto bytes = reinterpret_cast<const tako::U8*>(&value);
+		for (size_t i = 0; i < sizeof(T); i++)
+		{
+			m_hash = (m_hash ^ bytes[i]) * 1099511628211ull;
+		}
+	}
+
+	void Add(const tako::Vector2& vec)
+	{
+		Add(vec.x);
+		Add(vec.y);
+	}
+
+	tako::U64 Get() const
+	{
+		return m_hash;
+	}
+private:
+	tako::U64 m_hash = 14695981039346656037ull;
+};
@@ -0,0 +1,309 @@
+#pragma once
+#include <Math.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Timings.hpp"
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define SCHEDULER_THREADED 0
+#else
+#define SCHEDULER_THREADED 1
+#endif
+
+// One bit per component type, handed out on first use, so there can be at most 64 of them
+using ComponentMask = tako::U64;
+
+inline size_t NextComponentBit()
+{
+	static std::atomic<size_t> next = 0;
+	return next.fetch_add(1);
+}
+
+template<typename T>
+ComponentMask ComponentBit()
+{
+	static const ComponentMask bit = ComponentMask(1) << NextComponentBit();
+	return bit;
+}
+
+template<typename... T>
+ComponentMask Components()
+{
+	return (ComponentMask(0) | ... | ComponentBit<T>());
+}
+
+struct SystemAccess
+{
+	ComponentMask reads = 0;
+	ComponentMask writes = 0;
+
+	bool ConflictsWith(const SystemAccess& other) const
+	{
+		return (writes & (other.reads | other.writes)) || (other.writes & reads);
+	}
+};
+
+// Workers each own a queue and steal from the others once theirs is empty.
+// Threads waiting on jobs run queued jobs meanwhile, so jobs can wait on jobs they submitted.
+class ThreadPool
+{
+public:
+	using Job = std::function<void()>;
+
+	~ThreadPool()
+	{
+#if SCHEDULER_THREADED
+		{
+			std::lock_guard lock(m_sleepMutex);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto& worker : m_workers)
+		{
+			worker.join();
+		}
+#endif
+	}
+
+	// Without workers every job runs on the submitting thread
+	void Start(size_t workerCount)
+	{
+#if SCHEDULER_THREADED
+		// The first queue belongs to the thread that owns the pool
+		for (size_t i = 0; i <= workerCount; i++)
+		{
+			m_queues.push_back(std::make_unique<Queue>());
+		}
+		for (size_t i = 1; i <= workerCount; i++)
+		{
+			m_workers.emplace_back([this, i] { Work(i); });
+		}
+#endif
+	}
+
+	size_t GetWorkerCount() const
+	{
+		return m_workers.size();
+	}
+
+	void Submit(Job job)
+	{
+		if (m_workers.empty())
+		{
+			job();
+			return;
+		}
+		// Counted before it can be taken, so the count never drops below zero
+		{
+			std::lock_guard lock(m_sleepMutex);
+			m_queued++;
+		}
+		auto& queue = *m_queues[t_queueIndex];
+		{
+			std::lock_guard lock(queue.mutex);
+			queue.jobs.push_back(std::move(job));
+		}
+		m_wake.notify_one();
+	}
+
+	// Jobs someone waits on finish by calling this, it wakes the waiting thread once the count reaches zero
+	void Complete(std::atomic<size_t>& pending)
+	{
+		if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		{
+			std::lock_guard lock(m_sleepMutex);
+			m_wake.notify_all();
+		}
+	}
+
+	// Runs queued jobs until the count reaches zero, sleeps while there are none
+	void Wait(const std::atomic<size_t>& pending)
+	{
+		while (pending.load(std::memory_order_acquire) > 0)
+		{
+			if (TryRun(t_queueIndex))
+			{
+				continue;
+			}
+			std::unique_lock lock(m_sleepMutex);
+			m_wake.wait(lock, [&] { return pending.load(std::memory_order_acquire) == 0 || m_queued > 0; });
+		}
+	}
+
+	// Calls fn(begin, end) for chunks of the range, the calling thread takes the first chunk
+	template<typename Fn>
+	void ParallelFor(size_t count, size_t chunkSize, Fn&& fn)
+	{
+		if (count <= chunkSize || m_workers.empty())
+		{
+			fn(size_t(0), count);
+			return;
+		}
+		std::atomic<size_t> pending = (count - 1) / chunkSize;
+		for (size_t begin = chunkSize; begin < count; begin += chunkSize)
+		{
+			auto end = std::min(begin + chunkSize, count);
+			Submit([&, begin, end]
+			{
+				fn(begin, end);
+				Complete(pending);
+			});
+		}
+		fn(size_t(0), chunkSize);
+		Wait(pending);
+	}
+private:
+	struct Queue
+	{
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	inline static thread_local size_t t_queueIndex = 0;
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_workers;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wake;
+	size_t m_queued = 0;
+	bool m_stop = false;
+
+	// Newest job of the own queue first, oldest of the others when stealing
+	bool TryRun(size_t self)
+	{
+		Job job;
+		for (size_t i = 0; i < m_queues.size() && !job; i++)
+		{
+			auto& queue = *m_queues[(self + i) % m_queues.size()];
+			std::lock_guard lock(queue.mutex);
+			if (queue.jobs.empty())
+			{
+				continue;
+			}
+			if (i == 0)
+			{
+				job = std::move(queue.jobs.back());
+				queue.jobs.pop_back();
+			}
+			else
+			{
+				job = std::move(queue.jobs.front());
+				queue.jobs.pop_front();
+			}
+		}
+		if (!job)
+		{
+			return false;
+		}
+		{
+			std::lock_guard lock(m_sleepMutex);
+			m_queued--;
+		}
+		job();
+		return true;
+	}
+
+	void Work(size_t index)
+	{
+		t_queueIndex = index;
+		while (true)
+		{
+			if (TryRun(index))
+			{
+				continue;
+			}
+			std::unique_lock lock(m_sleepMutex);
+			m_wake.wait(lock, [&] { return m_stop || m_queued > 0; });
+			if (m_stop)
+			{
+				return;
+			}
+		}
+	}
+};
+
+// Systems are registered once with the components they read and write, the dependency graph is built as they are added.
+// Systems that don't conflict run at the same time, conflicting ones keep the order they were added in.
+// They may only touch the world through component access, structural changes would race with the other systems.
+// Per frame parameters are passed through members of the owner, running allocates nothing.
+class SystemScheduler
+{
+public:
+	void Add(SystemID id, SystemAccess access, std::function<void()> run)
+	{
+		auto index = m_systems.size();
+		size_t dependencies = 0;
+		for (size_t i = 0; i < index; i++)
+		{
+			if (m_systems[i].access.ConflictsWith(access))
+			{
+				m_systems[i].dependents.push_back(index);
+				dependencies++;
+			}
+		}
+		m_systems.push_back({id, access, std::move(run), {}, dependencies});
+		if (dependencies == 0)
+		{
+			m_roots.push_back(index);
+		}
+		m_waiting = std::make_unique<std::atomic<size_t>[]>(m_systems.size());
+	}
+
+	void Run(ThreadPool& pool)
+	{
+		m_pool = &pool;
+		for (size_t i = 0; i < m_systems.size(); i++)
+		{
+			m_waiting[i].store(m_systems[i].dependencies, std::memory_order_relaxed);
+		}
+		m_pending.store(m_systems.size(), std::memory_order_relaxed);
+		for (auto root : m_roots)
+		{
+			Launch(root);
+		}
+		pool.Wait(m_pending);
+	}
+private:
+	struct System
+	{
+		SystemID id;
+		SystemAccess access;
+		std::function<void()> run;
+		std::vector<size_t> dependents;
+		size_t dependencies;
+	};
+
+	std::vector<System> m_systems;
+	std::vector<size_t> m_roots;
+	std::unique_ptr<std::atomic<size_t>[]> m_waiting;
+	std::atomic<size_t> m_pending = 0;
+	ThreadPool* m_pool = nullptr;
+
+	// Captures no more than fits into std::function without allocating
+	void Launch(size_t index)
+	{
+		m_pool->Submit([this, index]
+		{
+			auto& system = m_systems[index];
+			{
+				// Off the main thread, only the profiler may see it
+				ScopedSystemTimer timer(nullptr, system.id);
+				system.run();
+			}
+			for (auto dependent : system.dependents)
+			{
+				if (m_waiting[dependent].fetch_sub(1, std::memory_order_acq_rel) == 1)
+				{
+					Launch(dependent);
+				}
+			}
+			m_pool->Complete(m_pending);
+		});
+	}
+};
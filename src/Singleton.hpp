@@ -0,0 +1,38 @@
+#pragma once
+#include <World.hpp>
+#include <optional>
+
+// Entity expected to exist at most once, like the player. Bound where it is created so lookups skip the archetype scan,
+// it has to be unbound whenever the world is reset.
+// Queries over many entities go through a CachedQuery instead.
+class Singleton
+{
+public:
+	void Bind(tako::Entity entity)
+	{
+		m_entity = entity;
+	}
+
+	void Unbind()
+	{
+		m_entity.reset();
+	}
+
+	bool IsBound() const
+	{
+		return m_entity.has_value();
+	}
+
+	tako::Entity GetEntity() const
+	{
+		return m_entity.value();
+	}
+
+	template<typename T>
+	T* Get(tako::World& world) const
+	{
+		return m_entity ? &world.GetComponent<T>(*m_entity) : nullptr;
+	}
+private:
+	std::optional<tako::Entity> m_entity;
+};
@@ -0,0 +1,152 @@
+#pragma once
+#include <Audio.hpp>
+#include <FileSystem.hpp>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include "LevelData.hpp"
+
+enum class Sound : tako::U8
+{
+	Jump,
+	Step,
+	Dash,
+	Land,
+	Activate,
+	Upgrade,
+	Collect,
+	Reset,
+	Count
+};
+
+struct SoundInfo
+{
+	const char* file;
+	// Lower priorities are dropped earlier as more sounds play at once, from 0 up to SoundBank::MaxPriority
+	tako::U8 priority;
+};
+
+constexpr const SoundInfo SoundInfos[] =
+{
+	{"/Jump.wav", 1},
+	{"/Step.wav", 0},
+	{"/Dash.wav", 1},
+	{"/Land.wav", 1},
+	{"/Activate.wav", 2},
+	{"/Upgrade.wav", 3},
+	{"/Collect.wav", 3},
+	{"/Reset.wav", 3}
+};
+
+static_assert(sizeof(SoundInfos) / sizeof(SoundInfo) == static_cast<size_t>(Sound::Count));
+
+// Length of a PCM wav file in seconds, 0 if the header can't be read
+inline float GetWavDuration(ArrayView<tako::U8> wav)
+{
+	if (wav.size() < 12 || std::memcmp(wav.data, "RIFF", 4) != 0)
+	{
+		return 0;
+	}
+	tako::U32 byteRate = 0;
+	size_t offset = 12;
+	while (offset + 8 <= wav.size())
+	{
+		tako::U32 chunkSize;
+		std::memcpy(&chunkSize, wav.data + offset + 4, sizeof(chunkSize));
+		if (std::memcmp(wav.data + offset, "fmt ", 4) == 0 && offset + 20 <= wav.size())
+		{
+			std::memcpy(&byteRate, wav.data + offset + 16, sizeof(byteRate));
+		}
+		else if (std::memcmp(wav.data + offset, "data", 4) == 0)
+		{
+			return byteRate > 0 ? static_cast<float>(chunkSize) / byteRate : 0;
+		}
+		offset += 8 + chunkSize + (chunkSize & 1);
+	}
+	return 0;
+}
+
+// The header chunks come before the samples, so a prefix of the file is enough
+constexpr const size_t WavHeaderReadSize = 512;
+
+inline float ReadWavDuration(const char* file)
+{
+	std::array<tako::U8, WavHeaderReadSize> header;
+	size_t bytesRead;
+	if (!tako::FileSystem::ReadFile(file, header.data(), header.size(), bytesRead))
+	{
+		return 0;
+	}
+	return GetWavDuration({header.data(), bytesRead});
+}
+
+// Used when a header can't be read, long enough that a broken file doesn't stop the limits from working
+constexpr const float FallbackSoundDuration = 1;
+
+// All sound effects are loaded once at audio init and played by handle.
+// tako can't stop or count playing sounds, so each play is remembered with its expected end in real time.
+// Low priority sounds are suppressed while many sounds are already playing, the ones already playing are never cut off.
+class SoundBank
+{
+public:
+	static constexpr size_t MaxPlaying = 8;
+	// Every priority level below the highest keeps this many more of the playing slots free
+	static constexpr size_t ReservedPerPriority = 2;
+	static constexpr tako::U8 MaxPriority = 3;
+
+	void Load(tako::Audio* audio)
+	{
+		m_audio = audio;
+		for (size_t i = 0; i < m_clips.size(); i++)
+		{
+			m_clips[i] = audio->Load(SoundInfos[i].file);
+			m_durations[i] = ReadWavDuration(SoundInfos[i].file);
+			if (m_durations[i] <= 0)
+			{
+				LOG("Could not read the length of {}, assuming {}s", SoundInfos[i].file, FallbackSoundDuration);
+				m_durations[i] = FallbackSoundDuration;
+			}
+		}
+	}
+
+	bool IsLoaded() const
+	{
+		return m_audio != nullptr;
+	}
+
+	void Play(Sound sound)
+	{
+		if (!m_audio)
+		{
+			return;
+		}
+		auto id = static_cast<size_t>(sound);
+		auto now = Clock::now();
+		size_t playing = 0;
+		Clock::time_point* freeSlot = nullptr;
+		for (auto& end : m_ends)
+		{
+			if (end > now)
+			{
+				playing++;
+			}
+			else if (!freeSlot)
+			{
+				freeSlot = &end;
+			}
+		}
+		if (!freeSlot || playing >= MaxPlaying - ReservedPerPriority * (MaxPriority - SoundInfos[id].priority))
+		{
+			return;
+		}
+		*freeSlot = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(m_durations[id]));
+		m_audio->Play(m_clips[id]);
+	}
+private:
+	using Clock = std::chrono::steady_clock;
+
+	tako::Audio* m_audio = nullptr;
+	std::array<tako::AudioClip*, static_cast<size_t>(Sound::Count)> m_clips;
+	std::array<float, static_cast<size_t>(Sound::Count)> m_durations;
+	std::array<Clock::time_point, MaxPlaying> m_ends{};
+};
@@ -0,0 +1,110 @@
+#pragma once
+#include <OpenGLPixelArtDrawer.hpp>
+#include <vector>
+#include "Comps.hpp"
+
+enum class QuadKind : tako::U8
+{
+	Rectangle,
+	Image,
+	Sprite
+};
+
+// A quad with the sprite variant already resolved, x and y are the top left corner like the drawer expects
+struct BatchQuad
+{
+	float x;
+	float y;
+	float width;
+	float height;
+	tako::Color color;
+	QuadKind kind;
+	tako::TextureHandle image;
+	const tako::OpenGLSprite* sprite;
+};
+
+// Collects the quads of one layer with their sprite variants resolved and submits them in the order they were added.
+// tako's drawer takes one quad per call, so reordering them by texture wouldn't save any draw calls.
+class SpriteBatch
+{
+public:
+	void AddRectangle(tako::Vector2 position, const RectRenderer& ren)
+	{
+		BatchQuad quad;
+		quad.x = position.x - ren.size.x / 2;
+		quad.y = position.y + ren.size.y / 2;
+		quad.width = ren.size.x;
+		quad.height = ren.size.y;
+		quad.color = ren.color;
+		quad.kind = QuadKind::Rectangle;
+		quad.sprite = nullptr;
+		m_quads.push_back(quad);
+	}
+
+	void AddSprite(tako::Vector2 position, const SpriteRenderer& ren)
+	{
+		BatchQuad quad;
+		if (auto tex = std::get_if<tako::Texture>(&ren.sprite))
+		{
+			quad.width = tex->width;
+			quad.height = tex->height;
+			// Images are drawn without tint
+			quad.color = {255, 255, 255, 255};
+			quad.kind = QuadKind::Image;
+			quad.image = tex->handle;
+			quad.sprite = nullptr;
+		}
+		else
+		{
+			auto sprite = std::get<tako::OpenGLSprite*>(ren.sprite);
+			quad.width = sprite->width;
+			quad.height = sprite->height;
+			quad.color = {255, 255, 255, ren.alpha};
+			quad.kind = QuadKind::Sprite;
+			quad.sprite = sprite;
+		}
+		quad.x = position.x + ren.offset.x - quad.width / 2;
+		quad.y = position.y + ren.offset.y + quad.height / 2;
+		m_quads.push_back(quad);
+	}
+
+	void AddSprite(float x, float y, float width, float height, const tako::OpenGLSprite* sprite, tako::Color color)
+	{
+		BatchQuad quad;
+		quad.x = x;
+		quad.y = y;
+		quad.width = width;
+		quad.height = height;
+		quad.color = color;
+		quad.kind = QuadKind::Sprite;
+		quad.sprite = sprite;
+		m_quads.push_back(quad);
+	}
+
+	void Submit(tako::OpenGLPixelArtDrawer* drawer)
+	{
+		for (auto& quad : m_quads)
+		{
+			switch (quad.kind)
+			{
+				case QuadKind::Rectangle:
+					drawer->DrawRectangle(quad.x, quad.y, quad.width, quad.height, quad.color);
+					break;
+				case QuadKind::Image:
+					drawer->DrawImage(quad.x, quad.y, quad.width, quad.height, quad.image);
+					break;
+				case QuadKind::Sprite:
+					drawer->DrawSprite(quad.x, quad.y, quad.width, quad.height, quad.sprite, quad.color);
+					break;
+			}
+		}
+		m_quads.clear();
+	}
+
+	size_t GetLength() const
+	{
+		return m_quads.size();
+	}
+private:
+	std::vector<BatchQuad> m_quads;
+};
@@ -0,0 +1,164 @@
+#pragma once
+#include <OpenGLPixelArtDrawer.hpp>
+#include <OpenGLSprite.hpp>
+#include <Bitmap.hpp>
+#include <Font.hpp>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <string_view>
+#include "SpriteBatch.hpp"
+
+// Where the glyphs are in a bitmap font, laid out row by row in the order of the charset
+struct GlyphAtlasLayout
+{
+	int glyphWidth;
+	int glyphHeight;
+	int originX;
+	int originY;
+	int pitchX;
+	int pitchY;
+};
+
+// Uploads the font bitmap once and draws text as one sprite quad per glyph
+class TextRenderer
+{
+public:
+	static constexpr int LetterSpacing = 1;
+	static constexpr int LineSpacing = 2;
+
+	void Init(tako::OpenGLPixelArtDrawer* drawer, const char* file, std::string_view charset, GlyphAtlasLayout layout)
+	{
+		m_layout = layout;
+		m_glyphs.fill(nullptr);
+		auto bitmap = tako::Bitmap::FromFile(file);
+		auto texture = drawer->CreateTexture(bitmap);
+		int perRow = (bitmap.Width() - layout.originX) / layout.pitchX;
+		for (size_t i = 0; i < charset.size(); i++)
+		{
+			auto index = static_cast<unsigned char>(charset[i]);
+			if (index >= m_glyphs.size())
+			{
+				continue;
+			}
+			float x = layout.originX + (i % perRow) * layout.pitchX;
+			float y = layout.originY + (i / perRow) * layout.pitchY;
+			auto sprite = drawer->CreateSprite(texture, x, y, layout.glyphWidth, layout.glyphHeight);
+			m_glyphs[index] = reinterpret_cast<tako::OpenGLSprite*>(sprite);
+		}
+#ifndef NDEBUG
+		if (!MatchesFont(bitmap, file, charset, 'A'))
+		{
+			LOG_ERR("Glyph layout of {} doesn't match the font it replaces", file);
+			ASSERT(false);
+		}
+#endif
+	}
+
+	// Size in pixels the text takes up at a scale of 1
+	tako::Vector2 Measure(std::string_view text) const
+	{
+		int lines = 1;
+		size_t lineLength = 0;
+		size_t longest = 0;
+		for (auto c : text)
+		{
+			if (c == '\n')
+			{
+				lines++;
+				lineLength = 0;
+				continue;
+			}
+			lineLength++;
+			longest = std::max(longest, lineLength);
+		}
+		float width = longest > 0 ? longest * GetAdvanceX() - LetterSpacing : 0;
+		float height = lines * GetAdvanceY() - LineSpacing;
+		return tako::Vector2(width, height);
+	}
+
+	// Adds the first visibleCount characters with the top left of the text at x, y
+	void Draw(SpriteBatch& batch, std::string_view text, float x, float y, float scale = 1, size_t visibleCount = std::string_view::npos) const
+	{
+		float cursorX = x;
+		float cursorY = y;
+		auto count = std::min(visibleCount, text.size());
+		for (size_t i = 0; i < count; i++)
+		{
+			auto c = text[i];
+			if (c == '\n')
+			{
+				cursorX = x;
+				cursorY -= GetAdvanceY() * scale;
+				continue;
+			}
+			if (auto glyph = GetGlyph(c))
+			{
+				batch.AddSprite(cursorX, cursorY, m_layout.glyphWidth * scale, m_layout.glyphHeight * scale, glyph, {255, 255, 255, 255});
+			}
+			cursorX += GetAdvanceX() * scale;
+		}
+	}
+
+	// Centers the whole text horizontally on x, the revealed part stays where it ends up once fully shown
+	void DrawCentered(SpriteBatch& batch, std::string_view text, float x, float y, float scale = 1, size_t visibleCount = std::string_view::npos) const
+	{
+		auto size = Measure(text);
+		Draw(batch, text, x - size.x * scale / 2, y, scale, visibleCount);
+	}
+private:
+#ifndef NDEBUG
+	// Compares the coverage of one glyph cut out by the layout with the glyph tako::Font renders from the same file
+	bool MatchesFont(const tako::Bitmap& bitmap, const char* file, std::string_view charset, char c) const
+	{
+		auto index = charset.find(c);
+		if (index == std::string_view::npos)
+		{
+			return true;
+		}
+		tako::Font font(file, m_layout.glyphWidth, m_layout.glyphHeight, m_layout.originX, m_layout.originY,
+			m_layout.pitchX - m_layout.glyphWidth, m_layout.pitchY - m_layout.glyphHeight, std::string(charset).c_str());
+		auto reference = font.RenderText(std::string_view(&c, 1), 1);
+		if (reference.Width() < m_layout.glyphWidth || reference.Height() < m_layout.glyphHeight)
+		{
+			return false;
+		}
+		int perRow = (bitmap.Width() - m_layout.originX) / m_layout.pitchX;
+		int glyphX = m_layout.originX + (index % perRow) * m_layout.pitchX;
+		int glyphY = m_layout.originY + (index / perRow) * m_layout.pitchY;
+		for (int y = 0; y < m_layout.glyphHeight; y++)
+		{
+			for (int x = 0; x < m_layout.glyphWidth; x++)
+			{
+				bool atlas = bitmap.GetData()[(glyphY + y) * bitmap.Width() + glyphX + x].a > 0;
+				bool rendered = reference.GetData()[y * reference.Width() + x].a > 0;
+				if (atlas != rendered)
+				{
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+#endif
+
+	// Only ASCII has glyphs, anything else draws nothing but still advances
+	const tako::OpenGLSprite* GetGlyph(char c) const
+	{
+		auto index = static_cast<unsigned char>(c);
+		return index < m_glyphs.size() ? m_glyphs[index] : nullptr;
+	}
+
+	int GetAdvanceX() const
+	{
+		return m_layout.glyphWidth + LetterSpacing;
+	}
+
+	int GetAdvanceY() const
+	{
+		return m_layout.glyphHeight + LineSpacing;
+	}
+
+	GlyphAtlasLayout m_layout;
+	std::array<tako::OpenGLSprite*, 128> m_glyphs;
+};
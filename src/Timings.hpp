@@ -0,0 +1,257 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+
+enum class SystemID
+{
+	LevelTransition,
+	PlayerUpdate,
+	CalculateMovement,
+	SimulatePhysics,
+	Clock,
+	GraphicsUpdate,
+	UpdateClockText,
+	UpdateBoxText,
+	LoadLevel,
+	PrepareLevel,
+	DrawEntities,
+	DrawTileLayer,
+	Animation,
+	CameraFollow,
+	Count
+};
+
+constexpr const char* SystemNames[] =
+{
+	"LevelTransition",
+	"PlayerUpdate",
+	"CalculateMovement",
+	"SimulatePhysics",
+	"Clock",
+	"GraphicsUpdate",
+	"UpdateClockText",
+	"UpdateBoxText",
+	"LoadLevel",
+	"PrepareLevel",
+	"DrawEntities",
+	"DrawTileLayer",
+	"Animation",
+	"CameraFollow"
+};
+
+static_assert(sizeof(SystemNames) / sizeof(SystemNames[0]) == static_cast<size_t>(SystemID::Count));
+
+struct SystemTimings
+{
+	std::array<double, static_cast<size_t>(SystemID::Count)> seconds{};
+};
+
+// Nanoseconds since the profiler started
+struct ProfileSample
+{
+	SystemID system;
+	std::int64_t start;
+	std::int64_t duration;
+};
+
+// Written only by the thread that owns it, read from anywhere without locking.
+// Every slot is a seqlock holding the index of the sample in it, odd while it is being written. Readers skip samples that
+// were being written or that the writer lapped while they were reading them.
+class ProfileRing
+{
+public:
+	static constexpr size_t Capacity = 4096;
+
+	void Push(const ProfileSample& sample)
+	{
+		auto head = m_head.load(std::memory_order_relaxed);
+		auto& slot = m_slots[head % Capacity];
+		slot.sequence.store(head * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.system.store(sample.system, std::memory_order_relaxed);
+		slot.start.store(sample.start, std::memory_order_relaxed);
+		slot.duration.store(sample.duration, std::memory_order_relaxed);
+		slot.sequence.store(head * 2 + 2, std::memory_order_release);
+		m_head.store(head + 1, std::memory_order_release);
+	}
+
+	template<typename Cb>
+	void ForEach(Cb&& callback) const
+	{
+		auto head = m_head.load(std::memory_order_acquire);
+		auto begin = head > Capacity ? head - Capacity : 0;
+		for (auto i = begin; i < head; i++)
+		{
+			auto& slot = m_slots[i % Capacity];
+			if (slot.sequence.load(std::memory_order_acquire) != i * 2 + 2)
+			{
+				continue;
+			}
+			ProfileSample sample;
+			sample.system = slot.system.load(std::memory_order_relaxed);
+			sample.start = slot.start.load(std::memory_order_relaxed);
+			sample.duration = slot.duration.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) != i * 2 + 2)
+			{
+				continue;
+			}
+			callback(sample);
+		}
+	}
+private:
+	struct Slot
+	{
+		std::atomic<size_t> sequence = 0;
+		std::atomic<SystemID> system = SystemID::Count;
+		std::atomic<std::int64_t> start = 0;
+		std::atomic<std::int64_t> duration = 0;
+	};
+
+	std::array<Slot, Capacity> m_slots;
+	std::atomic<size_t> m_head = 0;
+};
+
+// Keeps the recent scoped timer samples of every thread while enabled
+class Profiler
+{
+public:
+	static constexpr size_t MaxThreads = 16;
+
+	static Profiler& Get()
+	{
+		static Profiler profiler;
+		return profiler;
+	}
+
+	void SetEnabled(bool enabled)
+	{
+		m_enabled.store(enabled, std::memory_order_relaxed);
+	}
+
+	bool IsEnabled() const
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	void Record(SystemID system, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+	{
+		thread_local size_t threadIndex = m_threadCount.fetch_add(1);
+		if (threadIndex < MaxThreads)
+		{
+			m_rings[threadIndex].Push({system, ToNanoseconds(start - m_epoch), ToNanoseconds(end - start)});
+		}
+	}
+
+	// Durations in milliseconds of the latest samples of a system, oldest first, returns how many were written
+	size_t GetRecent(SystemID system, float* durations, size_t maxCount) const
+	{
+		if (maxCount == 0)
+		{
+			return 0;
+		}
+		// Written round robin, then rotated once so the oldest comes first
+		size_t count = 0;
+		ForEachSample([&](size_t thread, const ProfileSample& sample)
+		{
+			if (sample.system == system)
+			{
+				durations[count++ % maxCount] = sample.duration / 1000000.0f;
+			}
+		});
+		if (count <= maxCount)
+		{
+			return count;
+		}
+		std::rotate(durations, durations + count % maxCount, durations + maxCount);
+		return maxCount;
+	}
+
+	template<typename Cb>
+	void ForEachSample(Cb&& callback) const
+	{
+		auto threadCount = std::min(m_threadCount.load(std::memory_order_relaxed), MaxThreads);
+		for (size_t thread = 0; thread < threadCount; thread++)
+		{
+			m_rings[thread].ForEach([&](const ProfileSample& sample)
+			{
+				callback(thread, sample);
+			});
+		}
+	}
+
+	// Writes the samples in the Chrome trace event format, for chrome://tracing or Perfetto
+	bool WriteChromeTrace(const char* file) const
+	{
+		std::ofstream out(file, std::ios::trunc);
+		out << "{\"traceEvents\":[";
+		bool first = true;
+		ForEachSample([&](size_t thread, const ProfileSample& sample)
+		{
+			out << (first ? "" : ",") << "\n{\"name\":\"" << SystemNames[static_cast<size_t>(sample.system)]
+				<< "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread
+				<< ",\"ts\":" << sample.start / 1000.0 << ",\"dur\":" << sample.duration / 1000.0 << "}";
+			first = false;
+		});
+		out << "\n]}\n";
+		return static_cast<bool>(out);
+	}
+private:
+	static std::int64_t ToNanoseconds(std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+	}
+
+	std::chrono::steady_clock::time_point m_epoch = std::chrono::steady_clock::now();
+	std::atomic<bool> m_enabled = false;
+	std::atomic<size_t> m_threadCount = 0;
+	std::array<ProfileRing, MaxThreads> m_rings;
+};
+
+// Adds the time spent in the enclosing scope to the timings if any are attached, and to the profiler while it's enabled
+class ScopedSystemTimer
+{
+public:
+	ScopedSystemTimer(SystemTimings* timings, SystemID system) : m_timings(timings), m_system(system), m_profile(Profiler::Get().IsEnabled())
+	{
+		if (m_timings || m_profile)
+		{
+			m_start = std::chrono::steady_clock::now();
+		}
+	}
+
+	~ScopedSystemTimer()
+	{
+		Stop();
+	}
+
+	void Stop()
+	{
+		if (!m_timings && !m_profile)
+		{
+			return;
+		}
+		auto end = std::chrono::steady_clock::now();
+		if (m_timings)
+		{
+			std::chrono::duration<double> passed = end - m_start;
+			m_timings->seconds[static_cast<size_t>(m_system)] += passed.count();
+			m_timings = nullptr;
+		}
+		if (m_profile)
+		{
+			Profiler::Get().Record(m_system, m_start, end);
+			m_profile = false;
+		}
+	}
+private:
+	SystemTimings* m_timings;
+	SystemID m_system;
+	bool m_profile;
+	std::chrono::steady_clock::time_point m_start;
+};
@@ -0,0 +1,153 @@
+#pragma once
+#include <Entity.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "Comps.hpp"
+
+enum class TriggerType
+{
+	PlayerSpawn,
+	Upgrade,
+	Collectible
+};
+
+struct Trigger
+{
+	tako::Entity entity;
+	TriggerType type;
+	int id;
+	Rect rect;
+	bool active = true;
+};
+
+enum class TriggerPhase
+{
+	Enter,
+	Stay,
+	Exit
+};
+
+struct TriggerEvent
+{
+	TriggerPhase phase;
+	size_t index;
+};
+
+// Uniform grid over the static triggers of a level, rebuilt on every level load.
+// Querying only tests the triggers in the cells the rect touches and reports how the overlaps changed since the last query.
+class TriggerGrid
+{
+public:
+	void Build(tako::Vector2 levelSize, std::vector<Trigger> triggers)
+	{
+		m_triggers = std::move(triggers);
+		m_width = std::max(1, static_cast<int>(std::ceil(levelSize.x / CellSize)));
+		m_height = std::max(1, static_cast<int>(std::ceil(levelSize.y / CellSize)));
+
+		m_cellStart.assign(m_width * m_height + 1, 0);
+		for (auto& trigger : m_triggers)
+		{
+			ForEachCell(trigger.rect, [&](int cell) { m_cellStart[cell + 1]++; });
+		}
+		for (size_t i = 1; i < m_cellStart.size(); i++)
+		{
+			m_cellStart[i] += m_cellStart[i - 1];
+		}
+		m_cellTriggers.resize(m_cellStart.back());
+		std::vector<size_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+		for (size_t i = 0; i < m_triggers.size(); i++)
+		{
+			ForEachCell(m_triggers[i].rect, [&](int cell) { m_cellTriggers[fill[cell]++] = i; });
+		}
+
+		m_queried.assign(m_triggers.size(), 0);
+		m_query = 0;
+		m_overlapping.clear();
+	}
+
+	const std::vector<TriggerEvent>& Query(const Rect& rect)
+	{
+		m_query++;
+		m_current.clear();
+		ForEachCell(rect, [&](int cell)
+		{
+			for (auto i = m_cellStart[cell]; i < m_cellStart[cell + 1]; i++)
+			{
+				auto index = m_cellTriggers[i];
+				if (m_queried[index] == m_query)
+				{
+					continue;
+				}
+				m_queried[index] = m_query;
+				auto& trigger = m_triggers[index];
+				if (trigger.active && Rect::Overlap(rect, trigger.rect))
+				{
+					m_current.push_back(index);
+				}
+			}
+		});
+		std::sort(m_current.begin(), m_current.end());
+
+		m_events.clear();
+		size_t prev = 0;
+		size_t cur = 0;
+		while (prev < m_overlapping.size() || cur < m_current.size())
+		{
+			if (cur >= m_current.size() || (prev < m_overlapping.size() && m_overlapping[prev] < m_current[cur]))
+			{
+				m_events.push_back({TriggerPhase::Exit, m_overlapping[prev++]});
+			}
+			else if (prev >= m_overlapping.size() || m_current[cur] < m_overlapping[prev])
+			{
+				m_events.push_back({TriggerPhase::Enter, m_current[cur++]});
+			}
+			else
+			{
+				m_events.push_back({TriggerPhase::Stay, m_current[cur++]});
+				prev++;
+			}
+		}
+		std::swap(m_overlapping, m_current);
+		return m_events;
+	}
+
+	Trigger& Get(size_t index)
+	{
+		return m_triggers[index];
+	}
+
+	// The trigger stops overlapping anything, its exit is reported on the next query
+	void Remove(size_t index)
+	{
+		m_triggers[index].active = false;
+	}
+private:
+	static constexpr float CellSize = 64;
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<Trigger> m_triggers;
+	std::vector<size_t> m_cellStart;
+	std::vector<size_t> m_cellTriggers;
+	std::vector<size_t> m_queried;
+	size_t m_query = 0;
+	std::vector<size_t> m_overlapping;
+	std::vector<size_t> m_current;
+	std::vector<TriggerEvent> m_events;
+
+	template<typename Cb>
+	void ForEachCell(const Rect& rect, Cb&& callback)
+	{
+		int x0 = std::max(0, static_cast<int>(std::floor(rect.Left() / CellSize)));
+		int x1 = std::min(m_width - 1, static_cast<int>(std::floor(rect.Right() / CellSize)));
+		int y0 = std::max(0, static_cast<int>(std::floor(rect.Bottom() / CellSize)));
+		int y1 = std::min(m_height - 1, static_cast<int>(std::floor(rect.Top() / CellSize)));
+		for (int y = y0; y <= y1; y++)
+		{
+			for (int x = x0; x <= x1; x++)
+			{
+				callback(y * m_width + x);
+			}
+		}
+	}
+};
@@ -0,0 +1,256 @@
+#pragma once
+#include <FileSystem.hpp>
+#include <Jam/LDtkImporter.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LevelData.hpp"
+#include "LevelStreamer.hpp"
+
+// FNV-1a, pass the previous hash to continue it over more data
+inline tako::U64 HashAsset(const void* bytes, size_t size, tako::U64 hash = 14695981039346656037ull)
+{
+	auto data = static_cast<const tako::U8*>(bytes);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash = (hash ^ data[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+// Content hash of everything a level is built from, used to find the levels an edit touched
+inline tako::U64 HashLevel(const LevelWorld& world, const Level& level)
+{
+	auto hash = HashAsset(&level.size.x, sizeof(float));
+	hash = HashAsset(&level.size.y, sizeof(float), hash);
+	hash = HashAsset(&level.worldX, sizeof(int), hash);
+	hash = HashAsset(&level.worldY, sizeof(int), hash);
+	hash = HashAsset(&level.backgroundColor, sizeof(tako::Color), hash);
+	hash = HashAsset(&level.entityLayerIndex, sizeof(int), hash);
+	hash = HashAsset(level.neighbours.data, level.neighbours.size() * sizeof(tako::I32), hash);
+	hash = HashAsset(&level.collisionWidth, sizeof(int), hash);
+	hash = HashAsset(level.solidRows.data, level.solidRows.size() * sizeof(tako::U64), hash);
+	for (auto& layer : level.tileLayers)
+	{
+		auto& image = layer.composite;
+		hash = HashAsset(image.GetData(), sizeof(tako::Color) * image.Width() * image.Height(), hash);
+	}
+	for (auto& entity : level.entities)
+	{
+		// By name, type IDs shift when types are added
+		auto name = world.types[entity.typeID].name;
+		hash = HashAsset(name, std::strlen(name), hash);
+		hash = HashAsset(&entity.position.x, sizeof(float), hash);
+		hash = HashAsset(&entity.position.y, sizeof(float), hash);
+		hash = HashAsset(entity.values.data, entity.values.size() * sizeof(tako::I32), hash);
+	}
+	return hash;
+}
+
+inline std::vector<tako::U64> HashLevels(const LevelWorld& world)
+{
+	std::vector<tako::U64> hashes;
+	hashes.reserve(world.levels.size());
+	for (auto& level : world.levels)
+	{
+		hashes.push_back(HashLevel(world, level));
+	}
+	return hashes;
+}
+
+// A freshly imported world, ready to be swapped in
+struct WorldReload
+{
+	LevelWorld world;
+	std::vector<tako::U64> levelHashes;
+};
+
+// Modification time and size, compared before the file is read at all
+struct FileStamp
+{
+	std::filesystem::file_time_type time;
+	std::uintmax_t size;
+
+	bool operator==(const FileStamp& other) const
+	{
+		return time == other.time && size == other.size;
+	}
+
+	bool operator!=(const FileStamp& other) const
+	{
+		return !(*this == other);
+	}
+};
+
+// Watches the LDtk project for edits and reimports it on a worker thread.
+// Polls only stat the file. A change is picked up once the stamp stayed the same for a poll, so a project that is still
+// being saved isn't parsed, and the content is hashed then so a save without edits doesn't reimport.
+class WorldWatcher
+{
+public:
+	static constexpr auto PollInterval = std::chrono::milliseconds(500);
+
+	~WorldWatcher()
+	{
+#if LEVEL_STREAMER_THREADED
+		if (m_worker.joinable())
+		{
+			{
+				std::lock_guard lock(m_mutex);
+				m_stop = true;
+			}
+			m_condition.notify_all();
+			m_worker.join();
+		}
+#endif
+	}
+
+	void Start(const char* file)
+	{
+		m_file = file;
+		m_path = tako::FileSystem::GetAssetPath(file);
+#if LEVEL_STREAMER_THREADED
+		m_worker = std::thread([&] { Work(); });
+#endif
+	}
+
+	// Reimports even if the file didn't change
+	void Request()
+	{
+#if LEVEL_STREAMER_THREADED
+		{
+			std::lock_guard lock(m_mutex);
+			m_requested = true;
+		}
+		m_condition.notify_all();
+#else
+		m_ready = Import();
+#endif
+	}
+
+	// The latest finished import, if there is one since the last call
+	std::optional<WorldReload> Take()
+	{
+#if LEVEL_STREAMER_THREADED
+		std::lock_guard lock(m_mutex);
+#endif
+		auto reload = std::move(m_ready);
+		m_ready.reset();
+		return reload;
+	}
+private:
+	std::string m_file;
+	std::optional<WorldReload> m_ready;
+	std::string m_path;
+	std::optional<FileStamp> m_fileStamp;
+	std::optional<FileStamp> m_pendingStamp;
+	std::optional<tako::U64> m_fileHash;
+#if LEVEL_STREAMER_THREADED
+	std::thread m_worker;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_requested = false;
+	bool m_stop = false;
+
+	void Work()
+	{
+		std::unique_lock lock(m_mutex);
+		while (true)
+		{
+			m_condition.wait_for(lock, PollInterval, [&] { return m_stop || m_requested; });
+			if (m_stop)
+			{
+				return;
+			}
+			bool requested = m_requested;
+			m_requested = false;
+			lock.unlock();
+			auto reload = requested ? Import() : Poll();
+			lock.lock();
+			if (reload)
+			{
+				m_ready = std::move(reload);
+			}
+		}
+	}
+#endif
+
+	std::optional<tako::U64> ReadFileHash()
+	{
+		auto size = tako::FileSystem::GetFileSize(m_file.c_str());
+		std::vector<tako::U8> content(size);
+		size_t bytesRead;
+		if (size == 0 || !tako::FileSystem::ReadFile(m_file.c_str(), content.data(), content.size(), bytesRead))
+		{
+			return {};
+		}
+		return HashAsset(content.data(), bytesRead);
+	}
+
+	std::optional<FileStamp> ReadFileStamp()
+	{
+		std::error_code error;
+		auto time = std::filesystem::last_write_time(m_path, error);
+		if (error)
+		{
+			return {};
+		}
+		auto size = std::filesystem::file_size(m_path, error);
+		if (error)
+		{
+			return {};
+		}
+		return FileStamp{time, size};
+	}
+
+	std::optional<WorldReload> Poll()
+	{
+		auto stamp = ReadFileStamp();
+		if (!stamp || stamp == m_fileStamp)
+		{
+			m_pendingStamp.reset();
+			return {};
+		}
+		if (!m_fileStamp)
+		{
+			m_fileStamp = stamp;
+			m_fileHash = ReadFileHash();
+			return {};
+		}
+		if (stamp != m_pendingStamp)
+		{
+			m_pendingStamp = stamp;
+			return {};
+		}
+		auto hash = ReadFileHash();
+		if (hash && hash == m_fileHash)
+		{
+			m_fileStamp = stamp;
+			m_pendingStamp.reset();
+			return {};
+		}
+		return Import();
+	}
+
+	std::optional<WorldReload> Import()
+	{
+		m_fileStamp = ReadFileStamp();
+		m_fileHash = ReadFileHash();
+		m_pendingStamp.reset();
+		auto ldtk = tako::Jam::LDtkImporter::LoadWorld(m_file.c_str());
+		WorldReload reload;
+		if (!LoadLevelWorld(CookLevelWorld(ldtk), reload.world))
+		{
+			LOG("Reimporting {} failed", m_file);
+			return {};
+		}
+		reload.levelHashes = HashLevels(reload.world);
+		return reload;
+	}
+};